@@ -30,8 +30,15 @@
 #define HDRLINES       4 /* number of header lines in a trace file */
 #define LINENUM(i) (i+5) /* cnvt trace request nums to linenums (origin 1) */
 
+/* The heap trim check: fill blocks below the mapping threshold grow the
+   heap to TRIM_FILL_HEAP bytes, then a calloc grows it back after a trim */
+#define TRIM_FILL_BLOCKS 64
+#define TRIM_FILL_SIZE   200000
+#define TRIM_FILL_HEAP   (5 * (1 << 20))
+#define TRIM_CALLOC_SIZE 100000
+
 /* Returns true if p is ALIGNMENT-byte aligned */
-#define IS_ALIGNED(p)  ((((unsigned int)(p)) % ALIGNMENT) == 0)
+#define IS_ALIGNED(p)  ((((unsigned long)(p)) % ALIGNMENT) == 0)
 
 /****************************** 
  * The key compound data types 
@@ -48,7 +55,12 @@ typedef struct range_t {
 typedef struct {
     enum {ALLOC, FREE, REALLOC} type; /* type of request */
     int index;                        /* index for free() to use later */
-    int size;                         /* byte size of alloc/realloc request */
+    int size;                         /* byte size of alloc/realloc request,
+					 or of the block a free releases */
+    int hint;                         /* MM_*_LIVED hint of an alloc, 0 if none */
+    int align;                        /* alignment of a memalign, 0 for malloc */
+    int count;                        /* element count of a calloc, 0 for malloc */
+    int run;                          /* identical requests from here on (-B) */
 } traceop_t;
 
 /* Holds the information for one trace file*/
@@ -60,6 +72,7 @@ typedef struct {
     traceop_t *ops;      /* array of requests */
     char **blocks;       /* array of ptrs returned by malloc/realloc... */
     size_t *block_sizes; /* ... and a corresponding array of payload sizes */
+    size_t *block_caps;  /* ... and the bytes each block holds (-U), 0 = unknown */
 } trace_t;
 
 /* 
@@ -81,6 +94,8 @@ typedef struct {
 
     /* defined only for the student malloc package */
     double util;     /* space utilization for this trace (always 0 for libc) */
+    double final_heap; /* heap + mapped bytes after the last request */
+    double avg_heap;   /* heap + mapped bytes averaged over all requests */
 
     /* Note: secs and util are only defined if valid is true */
 } stats_t; 
@@ -92,6 +107,31 @@ int verbose = 0;        /* global flag for verbose output */
 static int errors = 0;  /* number of errs found when running student malloc */
 char msg[MAXLINE];      /* for whenever we need to compose an error message */
 
+/* Realloc headroom percent handed to the mm package (set by -H) */
+static int realloc_headroom = MM_REALLOC_HEADROOM;
+
+/* Pass the lifetime hints of a trace to mm_malloc_hint (cleared to compare) */
+static int use_hints = 1;
+
+/* Replay runs of identical requests through the mm batch calls (set by -B) */
+#define BATCH_MAX 64
+static int use_batch = 0;
+static void *batch_blocks[BATCH_MAX]; /* blocks of the current mm_malloc_batch */
+static int batch_next, batch_count;  /* next one to hand out, how many there are */
+static int batch_freed;              /* frees of the current run already done */
+
+/* Honour the alignment of memalign requests (cleared to compare) */
+static int use_align = 1;
+
+/* Free through mm_free_sized with the size the trace gave the block (-Z) */
+static int use_sized = 0;
+
+/* Grow blocks into their usable size before calling mm_realloc (-U) */
+static int use_slack = 0;
+
+/* Names of the mm placement policies, indexed by MM_POLICY_* (-P) */
+static char *policy_names[MM_NUM_POLICIES] = {"first", "next", "best", "addr"};
+
 /* Directory where default tracefiles are found */
 static char tracedir[MAXLINE] = TRACEDIR;
 
@@ -122,11 +162,27 @@ static void eval_libc_speed(void *ptr);
 /* Routines for evaluating correctnes, space utilization, and speed 
    of the student's malloc package in mm.c */
 static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges);
-static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges);
+static int eval_mm_huge(int tracenum);
+static int eval_mm_trim_calloc(int tracenum);
+static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges,
+			   stats_t *stats);
 static void eval_mm_speed(void *ptr);
 
 /* Various helper routines */
 static void printresults(int n, stats_t *stats);
+static void print_mm_stats(int tracenum, char *tracefile);
+static void print_headroom_cost(trace_t *trace, int tracenum, 
+				range_t **ranges, double util);
+static void print_hint_gain(trace_t *trace, int tracenum, 
+			    range_t **ranges, double util);
+static void print_align_cost(trace_t *trace, int tracenum, 
+			     range_t **ranges, double util);
+static void *libc_malloc_op(traceop_t *op);
+static void print_slack_gain(trace_t *trace, int tracenum, 
+			     range_t **ranges);
+static void *mm_malloc_op(trace_t *trace, int opnum);
+static void *mm_realloc_op(trace_t *trace, int opnum);
+static void mm_free_op(trace_t *trace, int opnum);
 static void usage(void);
 static void unix_error(char *msg);
 static void malloc_error(int tracenum, int opnum, char *msg);
@@ -150,6 +206,7 @@ int main(int argc, char **argv)
     int team_check = 1;  /* If set, check team structure (reset by -a) */
     int run_libc = 0;    /* If set, run libc malloc (set by -l) */
     int autograder = 0;  /* If set, emit summary info for autograder (-g) */
+    int print_stats = 0; /* If set, print mm allocator counters (-s) */
 
     /* temporaries used to compute the performance index */
     double secs, ops, util, avg_mm_util, avg_mm_throughput, p1, p2, perfindex;
@@ -158,7 +215,7 @@ int main(int argc, char **argv)
     /* 
      * Read and interpret the command line arguments 
      */
-    while ((c = getopt(argc, argv, "f:t:hvVgal")) != EOF) {
+    while ((c = getopt(argc, argv, "f:t:hvVgalsBUZF:G:H:P:S:")) != EOF) {
         switch (c) {
 	case 'g': /* Generate summary info for the autograder */
 	    autograder = 1;
@@ -184,6 +241,50 @@ int main(int argc, char **argv)
         case 'l': /* Run libc malloc */
             run_libc = 1;
             break;
+        case 'B': /* Replay runs of identical requests as mm batches */
+            use_batch = 1;
+            break;
+        case 'U': /* Grow blocks into their usable size */
+            use_slack = 1;
+            break;
+        case 'Z': /* Free with mm_free_sized */
+            use_sized = 1;
+            break;
+        case 's': /* Print mm allocator counters after each trace */
+            print_stats = 1;
+            mm_set_copy_timing(1);
+            break;
+        case 'F': /* Cap on the bytes held by one mm fastbin */
+            mm_set_fastbin_limit(atoi(optarg));
+            break;
+        case 'G': /* Heap growth policy of the mm package */
+	    {
+		unsigned long min_chunk;
+		int percent;
+
+		if (sscanf(optarg, "%lu,%d", &min_chunk, &percent) != 2) {
+		    usage();
+		    exit(1);
+		}
+		mm_set_heap_growth(min_chunk, percent);
+	    }
+            break;
+        case 'H': /* Percent of realloc headroom for growing blocks */
+            realloc_headroom = atoi(optarg);
+            mm_set_realloc_headroom(realloc_headroom);
+            break;
+        case 'P': /* Placement policy of the mm free lists */
+	    for (i = 0; i < MM_NUM_POLICIES; i++)
+		if (strcmp(optarg, policy_names[i]) == 0)
+		    break;
+	    if (mm_set_policy(i) < 0) {
+		usage();
+		exit(1);
+	    }
+            break;
+        case 'S': /* Largest span of mm slab pages */
+            mm_set_slab_span(atoi(optarg));
+            break;
         case 'v': /* Print per-trace performance breakdown */
             verbose = 1;
             break;
@@ -297,7 +398,14 @@ int main(int argc, char **argv)
 	if (mm_stats[i].valid) {
 	    if (verbose > 1)
 		printf("efficiency, ");
-	    mm_stats[i].util = eval_mm_util(trace, i, &ranges);
+	    mm_stats[i].util = eval_mm_util(trace, i, &ranges, &mm_stats[i]);
+	    if (print_stats) {
+		print_mm_stats(i, tracefiles[i]);
+		print_headroom_cost(trace, i, &ranges, mm_stats[i].util);
+		print_hint_gain(trace, i, &ranges, mm_stats[i].util);
+		print_align_cost(trace, i, &ranges, mm_stats[i].util);
+		print_slack_gain(trace, i, &ranges);
+	    }
 	    speed_params.trace = trace;
 	    speed_params.ranges = ranges;
 	    if (verbose > 1)
@@ -395,10 +503,11 @@ static int add_range(range_t **ranges, char *lo, int size,
         return 0;
     }
 
-    /* The payload must lie within the extent of the heap */
-    if ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) || 
-	(hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) {
-	sprintf(msg, "Payload (%p:%p) lies outside heap (%p:%p)",
+    /* The payload must lie within the extent of the heap or of a mem_map region */
+    if (((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) || 
+	 (hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) &&
+	!mem_is_mapped(lo, hi)) {
+	sprintf(msg, "Payload (%p:%p) lies outside heap (%p:%p) and mappings",
 		lo, hi, mem_heap_lo(), mem_heap_hi());
 	malloc_error(tracenum, opnum, msg);
         return 0;
@@ -476,10 +585,13 @@ static trace_t *read_trace(char *tracedir, char *filename)
     FILE *tracefile;
     trace_t *trace;
     char type[MAXLINE];
+    char line[MAXLINE];
+    char hint[2];
     char path[MAXLINE];
-    unsigned index, size;
+    unsigned index, size, align, count;
     unsigned max_index = 0;
     unsigned op_index;
+    int i;
 
     if (verbose > 1)
 	printf("Reading tracefile: %s\n", filename);
@@ -514,6 +626,11 @@ static trace_t *read_trace(char *tracedir, char *filename)
     if ((trace->block_sizes = 
 	 (size_t *)malloc(trace->num_ids * sizeof(size_t))) == NULL)
 	unix_error("malloc 4 failed in read_trace");
+
+    /* ... and, for -U, the bytes each block can hold */
+    if ((trace->block_caps = 
+	 (size_t *)malloc(trace->num_ids * sizeof(size_t))) == NULL)
+	unix_error("malloc 5 failed in read_trace");
     
     /* read every request line in the trace file */
     index = 0;
@@ -525,6 +642,34 @@ static trace_t *read_trace(char *tracedir, char *filename)
 	    trace->ops[op_index].type = ALLOC;
 	    trace->ops[op_index].index = index;
 	    trace->ops[op_index].size = size;
+	    /* an optional third column gives the lifetime: s(hort) or l(ong) */
+	    hint[0] = '\0';
+	    if (fgets(line, MAXLINE, tracefile) != NULL)
+		sscanf(line, "%1s", hint);
+	    trace->ops[op_index].hint = (hint[0] == 's') ? MM_SHORT_LIVED :
+		(hint[0] == 'l') ? MM_LONG_LIVED : 0;
+	    trace->ops[op_index].align = 0;
+	    trace->ops[op_index].count = 0;
+	    max_index = (index > max_index) ? index : max_index;
+	    break;
+	case 'c':
+	    fscanf(tracefile, "%u %u %u", &index, &count, &size);
+	    trace->ops[op_index].type = ALLOC;
+	    trace->ops[op_index].index = index;
+	    trace->ops[op_index].size = count * size;
+	    trace->ops[op_index].hint = 0;
+	    trace->ops[op_index].align = 0;
+	    trace->ops[op_index].count = count;
+	    max_index = (index > max_index) ? index : max_index;
+	    break;
+	case 'm':
+	    fscanf(tracefile, "%u %u %u", &index, &align, &size);
+	    trace->ops[op_index].type = ALLOC;
+	    trace->ops[op_index].index = index;
+	    trace->ops[op_index].size = size;
+	    trace->ops[op_index].hint = 0;
+	    trace->ops[op_index].align = align;
+	    trace->ops[op_index].count = 0;
 	    max_index = (index > max_index) ? index : max_index;
 	    break;
 	case 'r':
@@ -550,19 +695,42 @@ static trace_t *read_trace(char *tracedir, char *filename)
     fclose(tracefile);
     assert(max_index == trace->num_ids - 1);
     assert(trace->num_ops == op_index);
+
+    /* A free releases a block of the size of its last alloc or realloc */
+    for (i = 0; i < trace->num_ops; i++) {
+	if (trace->ops[i].type == FREE)
+	    trace->ops[i].size = trace->block_sizes[trace->ops[i].index];
+	else
+	    trace->block_sizes[trace->ops[i].index] = trace->ops[i].size;
+    }
+
+    /* Count the runs of identical requests: mallocs of one size, or frees */
+    for (i = trace->num_ops - 1; i >= 0; i--) {
+	traceop_t *op = &trace->ops[i], *next = op + 1;
+
+	op->run = 1;
+	if (i + 1 < trace->num_ops && next->type == op->type &&
+	    next->run < BATCH_MAX &&
+	    ((op->type == ALLOC && !op->hint && !next->hint && 
+	      !op->align && !next->align && !op->count && !next->count &&
+	      next->size == op->size) || 
+	     op->type == FREE))
+	    op->run = next->run + 1;
+    }
     
     return trace;
 }
 
 /*
- * free_trace - Free the trace record and the three arrays it points
+ * free_trace - Free the trace record and the four arrays it points
  *              to, all of which were allocated in read_trace().
  */
 void free_trace(trace_t *trace)
 {
-    free(trace->ops);         /* free the three arrays... */
+    free(trace->ops);         /* free the four arrays... */
     free(trace->blocks);      
     free(trace->block_sizes);
+    free(trace->block_caps);
     free(trace);              /* and the trace record itself... */
 }
 
@@ -584,6 +752,14 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
     char *oldp;
     char *p;
     
+    /* Requests that cannot be served have to fail cleanly */
+    if (!eval_mm_huge(tracenum))
+	return 0;
+
+    /* A heap that shrank and grows again must not leak into callocs */
+    if (!eval_mm_trim_calloc(tracenum))
+	return 0;
+
     /* Reset the heap and free any records in the range list */
     mem_reset_brk();
     clear_ranges(ranges);
@@ -604,7 +780,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
         case ALLOC: /* mm_malloc */
 
 	    /* Call the student's malloc */
-	    if ((p = mm_malloc(size)) == NULL) {
+	    if ((p = mm_malloc_op(trace, i)) == NULL) {
 		malloc_error(tracenum, i, "mm_malloc failed.");
 		return 0;
 	    }
@@ -616,6 +792,26 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	     */ 
 	    if (add_range(ranges, p, size, tracenum, i) == 0)
 		return 0;
+
+	    /* a memalign must honour its alignment as well */
+	    if (trace->ops[i].align && 
+		((unsigned long)p % trace->ops[i].align) != 0) {
+		sprintf(msg, "Payload address (%p) not aligned to %d bytes", 
+			p, trace->ops[i].align);
+		malloc_error(tracenum, i, msg);
+		return 0;
+	    }
+
+	    /* and a calloc must hand out zeroed bytes */
+	    if (trace->ops[i].count) {
+		for (j = 0; j < size; j++) {
+		    if (p[j] != 0) {
+			malloc_error(tracenum, i, "mm_calloc returned a block "
+				     "that is not zeroed");
+			return 0;
+		    }
+		}
+	    }
 	    
 	    /* ADDED: cgw
 	     * fill range with low byte of index.  This will be used later
@@ -633,7 +829,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	    
 	    /* Call the student's realloc */
 	    oldp = trace->blocks[index];
-	    if ((newp = mm_realloc(oldp, size)) == NULL) {
+	    if ((newp = mm_realloc_op(trace, i)) == NULL) {
 		malloc_error(tracenum, i, "mm_realloc failed.");
 		return 0;
 	    }
@@ -653,7 +849,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	    oldsize = trace->block_sizes[index];
 	    if (size < oldsize) oldsize = size;
 	    for (j = 0; j < oldsize; j++) {
-	      if (newp[j] != (index & 0xFF)) {
+	      if ((unsigned char)newp[j] != (index & 0xFF)) {
 		malloc_error(tracenum, i, "mm_realloc did not preserve the "
 			     "data from old block");
 		return 0;
@@ -671,7 +867,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	    /* Remove region from list and call student's free function */
 	    p = trace->blocks[index];
 	    remove_range(ranges, p);
-	    mm_free(p);
+	    mm_free_op(trace, i);
 	    break;
 
 	default:
@@ -684,26 +880,149 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
     return 1;
 }
 
+/*
+ * eval_mm_huge - Check that mm requests whose size is close to the
+ *     largest size_t (or whose calloc product overflows) return NULL
+ *     instead of wrapping around to a small block, and that a realloc
+ *     to such a size leaves the old block as it was.
+ */
+static int eval_mm_huge(int tracenum)
+{
+    static size_t sizes[] = {(size_t)-1, (size_t)-1 - 4, (size_t)-1 - 8,
+			     (size_t)-1 - 11, (size_t)-1 - 12, (size_t)-1 - 16,
+			     (size_t)-1 - 4096};
+    static size_t old_sizes[] = {8, 1000, 1 << 20};
+    int nsizes = sizeof(sizes) / sizeof(sizes[0]);
+    int nold = sizeof(old_sizes) / sizeof(old_sizes[0]);
+    int i, j;
+    size_t actual;
+    char *p, *oldp;
+
+    mem_reset_brk();
+    if (mm_init() < 0) {
+	malloc_error(tracenum, 0, "mm_init failed.");
+	return 0;
+    }
+
+    for (i = 0; i < nsizes; i++) {
+	if (mm_malloc(sizes[i]) != NULL || 
+	    mm_malloc_at_least(sizes[i], &actual) != NULL ||
+	    mm_memalign(64, sizes[i]) != NULL || 
+	    mm_malloc_batch(sizes[i], 1, batch_blocks) != 0) {
+	    sprintf(msg, "mm allocated a block of %lu bytes", 
+		    (unsigned long)sizes[i]);
+	    malloc_error(tracenum, 0, msg);
+	    return 0;
+	}
+    }
+    if (mm_calloc((size_t)-1 / 2 + 1, 2) != NULL || 
+	mm_calloc(3, (size_t)-1 / 3 + 1) != NULL) {
+	malloc_error(tracenum, 0, "mm_calloc ignored an overflowing product");
+	return 0;
+    }
+
+    /* a slab slot, an ordinary block and a mapping */
+    for (j = 0; j < nold; j++) {
+	if ((oldp = mm_malloc(old_sizes[j])) == NULL) {
+	    malloc_error(tracenum, 0, "mm_malloc failed.");
+	    return 0;
+	}
+	memset(oldp, 0x5a, old_sizes[j]);
+	for (i = 0; i < nsizes; i++) {
+	    if ((p = mm_realloc(oldp, sizes[i])) != NULL) {
+		sprintf(msg, "mm_realloc grew a block to %lu bytes", 
+			(unsigned long)sizes[i]);
+		malloc_error(tracenum, 0, msg);
+		return 0;
+	    }
+	}
+	for (i = 0; i < old_sizes[j]; i++) {
+	    if (oldp[i] != 0x5a) {
+		malloc_error(tracenum, 0, "a failed mm_realloc changed the block");
+		return 0;
+	    }
+	}
+	mm_free(oldp);
+    }
+    return 1;
+}
+
+/*
+ * eval_mm_trim_calloc - Check that a calloc carved from a heap that
+ *     was trimmed and then grown again is zeroed. A small block placed
+ *     on a large fresh heap extension is freed, which trims the heap
+ *     and leaves its new top footer and epilogue behind; the calloc
+ *     then grows the heap back over them. Memory that memlib never
+ *     handed out before is only there before the first trace, so
+ *     later calls do not reach this path and simply pass.
+ */
+static int eval_mm_trim_calloc(int tracenum)
+{
+    char *fill[TRIM_FILL_BLOCKS];
+    char *p;
+    int i, n;
+
+    mem_reset_brk();
+    if (mm_init() < 0) {
+	malloc_error(tracenum, 0, "mm_init failed.");
+	return 0;
+    }
+
+    /* grow the heap until its growth chunk is far above the trim threshold */
+    for (n = 0; n < TRIM_FILL_BLOCKS && mem_heapsize() < TRIM_FILL_HEAP; n++) {
+	if ((fill[n] = mm_malloc(TRIM_FILL_SIZE)) == NULL) {
+	    malloc_error(tracenum, 0, "mm_malloc failed.");
+	    return 0;
+	}
+    }
+
+    if ((p = mm_malloc(1000)) == NULL) {
+	malloc_error(tracenum, 0, "mm_malloc failed.");
+	return 0;
+    }
+    memset(p, 0x5a, 1000);
+    mm_free(p);
+
+    if ((p = mm_calloc(1, TRIM_CALLOC_SIZE)) == NULL) {
+	malloc_error(tracenum, 0, "mm_calloc failed.");
+	return 0;
+    }
+    for (i = 0; i < TRIM_CALLOC_SIZE; i++) {
+	if (p[i] != 0) {
+	    sprintf(msg, "mm_calloc after a heap trim left byte %d of %d "
+		    "nonzero", i, TRIM_CALLOC_SIZE);
+	    malloc_error(tracenum, 0, msg);
+	    return 0;
+	}
+    }
+    mm_free(p);
+    for (i = 0; i < n; i++)
+	mm_free(fill[i]);
+    return 1;
+}
+
 /* 
  * eval_mm_util - Evaluate the space utilization of the student's package
  *   The idea is to remember the high water mark "hwm" of the heap for 
  *   an optimal allocator, i.e., no gaps and no internal fragmentation.
  *   Utilization is the ratio hwm/heapsize, where heapsize is the 
- *   size of the heap in bytes after running the student's malloc 
- *   package on the trace. Note that our implementation of mem_sbrk() 
- *   doesn't allow the students to decrement the brk pointer, so brk
- *   is always the high water mark of the heap. 
+ *   peak size of the heap in bytes while running the student's malloc 
+ *   package on the trace, mem_map regions included. Since mem_sbrk() lets the package decrement
+ *   the brk pointer, the final and the time-averaged (over requests)
+ *   heap sizes are recorded in stats as well.
  *   
  */
-static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
+static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges,
+			   stats_t *stats)
 {   
     int i;
     int index;
     int size, newsize, oldsize;
     int max_total_size = 0;
     int total_size = 0;
+    double heap_sum = 0;
     char *p;
-    char *newp, *oldp;
+    char *newp;
 
     /* initialize the heap and the mm malloc package */
     mem_reset_brk();
@@ -717,7 +1036,7 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    index = trace->ops[i].index;
 	    size = trace->ops[i].size;
 
-	    if ((p = mm_malloc(size)) == NULL) 
+	    if ((p = mm_malloc_op(trace, i)) == NULL) 
 		app_error("mm_malloc failed in eval_mm_util");
 	    
 	    /* Remember region and size */
@@ -738,8 +1057,7 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    newsize = trace->ops[i].size;
 	    oldsize = trace->block_sizes[index];
 
-	    oldp = trace->blocks[index];
-	    if ((newp = mm_realloc(oldp,newsize)) == NULL)
+	    if ((newp = mm_realloc_op(trace, i)) == NULL)
 		app_error("mm_realloc failed in eval_mm_util");
 
 	    /* Remember region and size */
@@ -760,7 +1078,7 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    size = trace->block_sizes[index];
 	    p = trace->blocks[index];
 	    
-	    mm_free(p);
+	    mm_free_op(trace, i);
 	    
 	    /* Keep track of current total size
 	     * of all allocated blocks */
@@ -772,9 +1090,12 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    app_error("Nonexistent request type in eval_mm_util");
 
         }
+	heap_sum += mem_heapsize() + mem_mapsize();
     }
 
-    return ((double)max_total_size / (double)mem_heapsize());
+    stats->final_heap = mem_heapsize() + mem_mapsize();
+    stats->avg_heap = heap_sum / trace->num_ops;
+    return ((double)max_total_size / (double)mem_peak_heapsize());
 }
 
 
@@ -784,8 +1105,8 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
  */
 static void eval_mm_speed(void *ptr)
 {
-    int i, index, size, newsize;
-    char *p, *newp, *oldp, *block;
+    int i, index;
+    char *p, *newp;
     trace_t *trace = ((speed_t *)ptr)->trace;
 
     /* Reset the heap and initialize the mm package */
@@ -799,25 +1120,20 @@ static void eval_mm_speed(void *ptr)
 
         case ALLOC: /* mm_malloc */
             index = trace->ops[i].index;
-            size = trace->ops[i].size;
-            if ((p = mm_malloc(size)) == NULL)
+            if ((p = mm_malloc_op(trace, i)) == NULL)
 		app_error("mm_malloc error in eval_mm_speed");
             trace->blocks[index] = p;
             break;
 
 	case REALLOC: /* mm_realloc */
 	    index = trace->ops[i].index;
-            newsize = trace->ops[i].size;
-	    oldp = trace->blocks[index];
-            if ((newp = mm_realloc(oldp,newsize)) == NULL)
+            if ((newp = mm_realloc_op(trace, i)) == NULL)
 		app_error("mm_realloc error in eval_mm_speed");
             trace->blocks[index] = newp;
             break;
 
         case FREE: /* mm_free */
-            index = trace->ops[i].index;
-            block = trace->blocks[index];
-            mm_free(block);
+            mm_free_op(trace, i);
             break;
 
 	default:
@@ -840,7 +1156,7 @@ static int eval_libc_valid(trace_t *trace, int tracenum)
         switch (trace->ops[i].type) {
 
         case ALLOC: /* malloc */
-	    if ((p = malloc(trace->ops[i].size)) == NULL) {
+	    if ((p = libc_malloc_op(&trace->ops[i])) == NULL) {
 		malloc_error(tracenum, i, "libc malloc failed");
 		unix_error("System message");
 	    }
@@ -877,7 +1193,7 @@ static int eval_libc_valid(trace_t *trace, int tracenum)
 static void eval_libc_speed(void *ptr)
 {
     int i;
-    int index, size, newsize;
+    int index, newsize;
     char *p, *newp, *oldp, *block;
     trace_t *trace = ((speed_t *)ptr)->trace;
 
@@ -885,8 +1201,7 @@ static void eval_libc_speed(void *ptr)
         switch (trace->ops[i].type) {
         case ALLOC: /* malloc */
 	    index = trace->ops[i].index;
-	    size = trace->ops[i].size;
-	    if ((p = malloc(size)) == NULL)
+	    if ((p = libc_malloc_op(&trace->ops[i])) == NULL)
 		unix_error("malloc failed in eval_libc_speed");
 	    trace->blocks[index] = p;
 	    break;
@@ -926,17 +1241,19 @@ static void printresults(int n, stats_t *stats)
     double util = 0;
 
     /* Print the individual results for each trace */
-    printf("%5s%7s %5s%8s%10s%6s\n", 
-	   "trace", " valid", "util", "ops", "secs", "Kops");
+    printf("%5s%7s %5s%8s%10s%6s%9s%9s\n", 
+	   "trace", " valid", "util", "ops", "secs", "Kops", "finalKB", "avgKB");
     for (i=0; i < n; i++) {
 	if (stats[i].valid) {
-	    printf("%2d%10s%5.0f%%%8.0f%10.6f%6.0f\n", 
+	    printf("%2d%10s%5.0f%%%8.0f%10.6f%6.0f%9.0f%9.0f\n", 
 		   i,
 		   "yes",
 		   stats[i].util*100.0,
 		   stats[i].ops,
 		   stats[i].secs,
-		   (stats[i].ops/1e3)/stats[i].secs);
+		   (stats[i].ops/1e3)/stats[i].secs,
+		   stats[i].final_heap/1024,
+		   stats[i].avg_heap/1024);
 	    secs += stats[i].secs;
 	    ops += stats[i].ops;
 	    util += stats[i].util;
@@ -972,6 +1289,266 @@ static void printresults(int n, stats_t *stats)
 
 }
 
+/*
+ * print_mm_stats - prints the mm package counters left by the last
+ *     run of a trace (the eval_mm_util run, which is not timed)
+ */
+static void print_mm_stats(int tracenum, char *tracefile)
+{
+    int i;
+    mm_stats_t stats;
+    static char *realloc_paths[MM_NUM_REALLOC_PATHS] = 
+	{"in place", "top", "next", "prev", "copy", "remap"};
+
+    mm_get_stats(&stats);
+    printf("\nStats for trace %d (%s):\n", tracenum, tracefile);
+    printf("%10s%10s%10s\n", "fastbin", "bytes", "peak");
+    for (i = 0; i < MM_NUM_FASTBINS; i++) {
+	if (stats.fastbin_peak[i] == 0)
+	    continue;
+	printf("%10d%10lu%10lu\n", MM_FASTBIN_MIN + 8*i,
+	       (unsigned long)stats.fastbin_bytes[i],
+	       (unsigned long)stats.fastbin_peak[i]);
+    }
+    printf("%10s%10s\n", "realloc", "calls");
+    for (i = 0; i < MM_NUM_REALLOC_PATHS; i++) {
+	if (stats.realloc_count[i] == 0)
+	    continue;
+	printf("%10s%10lu\n", realloc_paths[i],
+	       (unsigned long)stats.realloc_count[i]);
+    }
+    printf("%10s%10lu\n", "copied", (unsigned long)stats.realloc_copy_bytes);
+    if (stats.realloc_copy_ns > 0)
+	printf("%10s%10.0f\n", "MB/s", 
+	       stats.realloc_copy_bytes / stats.realloc_copy_ns * 1e3);
+    printf("%10s%10d\n", "sbrk", mem_sbrk_calls());
+    printf("%10s%10s%10s\n", "headroom", "peak", "reclaimed");
+    printf("%10lu%10lu%10lu\n", (unsigned long)stats.headroom_bytes,
+	   (unsigned long)stats.headroom_peak,
+	   (unsigned long)stats.headroom_reclaimed);
+    if (stats.calloc_bytes > 0) {
+	printf("%10s%10s\n", "calloc", "cleared");
+	printf("%10lu%10lu\n", (unsigned long)stats.calloc_bytes,
+	       (unsigned long)stats.calloc_cleared);
+    }
+}
+
+/*
+ * print_headroom_cost - reruns the utilization check of a trace that
+ *     reallocs with the realloc headroom turned off, and prints the 
+ *     bytes copied by mm_realloc and the utilization with and without it
+ */
+static void print_headroom_cost(trace_t *trace, int tracenum, 
+				range_t **ranges, double util)
+{
+    mm_stats_t with, without;
+    stats_t scratch;
+    double util_without;
+    int i;
+
+    for (i = 0; i < trace->num_ops; i++)
+	if (trace->ops[i].type == REALLOC)
+	    break;
+    if (i == trace->num_ops || realloc_headroom == 0)
+	return;
+
+    mm_get_stats(&with);
+    mm_set_realloc_headroom(0);
+    util_without = eval_mm_util(trace, tracenum, ranges, &scratch);
+    mm_get_stats(&without);
+    mm_set_realloc_headroom(realloc_headroom);
+
+    printf("%10s%10s%10s\n", "headroom", "copied", "util");
+    printf("%9d%%%10lu%9.1f%%\n", realloc_headroom,
+	   (unsigned long)with.realloc_copy_bytes, util*100.0);
+    printf("%9d%%%10lu%9.1f%%\n", 0,
+	   (unsigned long)without.realloc_copy_bytes, util_without*100.0);
+}
+
+/*
+ * print_hint_gain - reruns the utilization check of a trace that gives
+ *     lifetime hints with the hints ignored, and prints the utilization
+ *     with and without them
+ */
+static void print_hint_gain(trace_t *trace, int tracenum, 
+			    range_t **ranges, double util)
+{
+    stats_t scratch;
+    double util_without;
+    int i;
+
+    for (i = 0; i < trace->num_ops; i++)
+	if (trace->ops[i].type == ALLOC && trace->ops[i].hint)
+	    break;
+    if (i == trace->num_ops)
+	return;
+
+    use_hints = 0;
+    util_without = eval_mm_util(trace, tracenum, ranges, &scratch);
+    use_hints = 1;
+
+    printf("%10s%10s\n", "hints", "util");
+    printf("%10s%9.1f%%\n", "used", util*100.0);
+    printf("%10s%9.1f%%\n", "ignored", util_without*100.0);
+}
+
+/*
+ * print_align_cost - reruns the utilization check of a trace that
+ *     memaligns with every memalign turned into a plain mm_malloc, and
+ *     prints the utilization with and without the alignment
+ */
+static void print_align_cost(trace_t *trace, int tracenum, 
+			     range_t **ranges, double util)
+{
+    stats_t scratch;
+    double util_without;
+    int i;
+
+    for (i = 0; i < trace->num_ops; i++)
+	if (trace->ops[i].type == ALLOC && trace->ops[i].align)
+	    break;
+    if (i == trace->num_ops)
+	return;
+
+    use_align = 0;
+    util_without = eval_mm_util(trace, tracenum, ranges, &scratch);
+    use_align = 1;
+
+    printf("%10s%10s\n", "alignment", "util");
+    printf("%10s%9.1f%%\n", "honoured", util*100.0);
+    printf("%10s%9.1f%%\n", "ignored", util_without*100.0);
+}
+
+/*
+ * print_slack_gain - reruns the utilization check of a trace that
+ *     reallocs with and without -U, and prints the mm_realloc calls
+ *     and the utilization of both runs
+ */
+static void print_slack_gain(trace_t *trace, int tracenum, 
+			     range_t **ranges)
+{
+    mm_stats_t stats;
+    stats_t scratch;
+    double util[2];
+    size_t calls[2];
+    int i, slack;
+
+    for (i = 0; i < trace->num_ops; i++)
+	if (trace->ops[i].type == REALLOC)
+	    break;
+    if (i == trace->num_ops)
+	return;
+
+    slack = use_slack;
+    for (use_slack = 0; use_slack < 2; use_slack++) {
+	util[use_slack] = eval_mm_util(trace, tracenum, ranges, &scratch);
+	mm_get_stats(&stats);
+	calls[use_slack] = 0;
+	for (i = 0; i < MM_NUM_REALLOC_PATHS; i++)
+	    calls[use_slack] += stats.realloc_count[i];
+    }
+    use_slack = slack;
+
+    printf("%10s%10s%10s\n", "slack", "reallocs", "util");
+    printf("%10s%10lu%9.1f%%\n", "ignored", (unsigned long)calls[0], util[0]*100.0);
+    printf("%10s%10lu%9.1f%%\n", "used", (unsigned long)calls[1], util[1]*100.0);
+}
+
+/*
+ * mm_malloc_op - mm_malloc for a trace alloc, mm_calloc for a calloc,
+ *     mm_memalign for a memalign, through mm_malloc_hint when the trace gives the block a
+ *     lifetime; with -B runs of equal mallocs come from one mm_malloc_batch,
+ *     with -U plain mallocs go through mm_malloc_at_least
+ */
+static void *mm_malloc_op(trace_t *trace, int opnum)
+{
+    traceop_t *op = &trace->ops[opnum];
+
+    trace->block_caps[op->index] = 0;
+
+    /* with -B the first malloc of a run allocates the whole run */
+    if (batch_next < batch_count)
+	return batch_blocks[batch_next++];
+    if (use_batch && op->run > 1) {
+	batch_count = mm_malloc_batch(op->size, op->run, batch_blocks);
+	batch_next = 0;
+	if (batch_count > 0)
+	    return batch_blocks[batch_next++];
+    }
+
+    if (op->count)
+	return mm_calloc(op->count, op->size / op->count);
+    if (use_align && op->align)
+	return mm_memalign(op->align, op->size);
+    if (use_hints && op->hint)
+	return mm_malloc_hint(op->size, op->hint);
+    if (use_slack)
+	return mm_malloc_at_least(op->size, &trace->block_caps[op->index]);
+    return mm_malloc(op->size);
+}
+
+/*
+ * mm_realloc_op - mm_realloc for a trace realloc; with -U, like a
+ *     container that knows its capacity, a request the block already
+ *     holds does not call mm_realloc at all
+ */
+static void *mm_realloc_op(trace_t *trace, int opnum)
+{
+    traceop_t *op = &trace->ops[opnum];
+    char *p = trace->blocks[op->index];
+
+    if (!use_slack)
+	return mm_realloc(p, op->size);
+    if (op->size <= trace->block_caps[op->index])
+	return p;
+    if ((p = mm_realloc(p, op->size)) != NULL)
+	trace->block_caps[op->index] = mm_usable_size(p);
+    return p;
+}
+
+/*
+ * libc_malloc_op - malloc for a trace alloc, calloc for a calloc,
+ *     posix_memalign for a memalign
+ */
+static void *libc_malloc_op(traceop_t *op)
+{
+    void *p;
+
+    if (op->count)
+	return calloc(op->count, op->size / op->count);
+    if (op->align)
+	return posix_memalign(&p, op->align, op->size) ? NULL : p;
+    return malloc(op->size);
+}
+
+/*
+ * mm_free_op - mm_free for a trace free, mm_free_sized with -Z; with -B
+ *     the first free of a run frees the whole run through mm_free_batch
+ */
+static void mm_free_op(trace_t *trace, int opnum)
+{
+    traceop_t *op = &trace->ops[opnum];
+    void *ptrs[BATCH_MAX];
+    int i;
+
+    if (batch_freed > 0) {
+	batch_freed--;
+	return;
+    }
+    if (use_batch && op->run > 1) {
+	for (i = 0; i < op->run; i++)
+	    ptrs[i] = trace->blocks[op[i].index];
+	mm_free_batch(ptrs, op->run);
+	batch_freed = op->run - 1;
+	return;
+    }
+
+    if (use_sized)
+	mm_free_sized(trace->blocks[op->index], op->size);
+    else
+	mm_free(trace->blocks[op->index]);
+}
+
 /* 
  * app_error - Report an arbitrary application error
  */
@@ -1004,14 +1581,25 @@ void malloc_error(int tracenum, int opnum, char *msg)
  */
 static void usage(void) 
 {
-    fprintf(stderr, "Usage: mdriver [-hvVal] [-f <file>] [-t <dir>]\n");
+    fprintf(stderr, "Usage: mdriver [-hvValsBUZ] [-f <file>] [-t <dir>] [-F <bytes>] [-H <percent>]\n");
+    fprintf(stderr, "               [-G <bytes>,<percent>] [-P first|next|best|addr] [-S <pages>]\n");
     fprintf(stderr, "Options\n");
     fprintf(stderr, "\t-a         Don't check the team structure.\n");
+    fprintf(stderr, "\t-B         Replay runs of identical mallocs and frees as mm batches.\n");
     fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
+    fprintf(stderr, "\t-F <bytes> Cap the bytes held by one mm fastbin (0 disables them).\n");
     fprintf(stderr, "\t-g         Generate summary info for autograder.\n");
+    fprintf(stderr, "\t-G <b>,<p> Grow the mm heap by at least <b> bytes, at most <p>%% of it (0,0 = exact).\n");
     fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-H <pct>   Realloc headroom for growing blocks (0 disables it).\n");
     fprintf(stderr, "\t-l         Run libc malloc as well.\n");
+    fprintf(stderr, "\t-P <name>  Free list placement policy: first fit (default), next fit,\n");
+    fprintf(stderr, "\t           best of a few fits or address-ordered first fit.\n");
+    fprintf(stderr, "\t-s         Print mm allocator counters after each trace.\n");
+    fprintf(stderr, "\t-S <pages> Largest span the mm slab pages are carved from (1 = page by page).\n");
     fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
+    fprintf(stderr, "\t-U         Grow blocks into their mm_usable_size before calling mm_realloc.\n");
     fprintf(stderr, "\t-v         Print per-trace performance breakdowns.\n");
     fprintf(stderr, "\t-V         Print additional debug info.\n");
+    fprintf(stderr, "\t-Z         Free with mm_free_sized, passing the size from the trace.\n");
 }
@@ -3,6 +3,7 @@
  *            allows us to interleave calls from the student's malloc package 
  *            with the system's malloc package in libc.
  */
+#define _GNU_SOURCE             /* for mremap */
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -18,6 +19,21 @@
 static char *mem_start_brk;  /* points to first byte of heap */
 static char *mem_brk;        /* points to last byte of heap */
 static char *mem_max_addr;   /* largest legal heap address */ 
+static size_t mem_peak;      /* largest heap + mapped bytes since the last reset */
+static int mem_sbrk_count;   /* mem_sbrk calls since the last reset */
+
+/* regions handed out by mem_map, separate from the sbrk heap */
+typedef struct {
+    char *lo;                /* first byte of the mapping */
+    size_t size;             /* length of the mapping in bytes */
+} mem_region_t;
+
+static mem_region_t *mem_maps; /* the live mappings, in no particular order */
+static int mem_map_count;    /* number of live mappings */
+static int mem_map_max;      /* capacity of mem_maps */
+static size_t mem_mapped;    /* bytes in the live mappings */
+
+static void mem_note_peak(void);
 
 /* 
  * mem_init - initialize the memory system model
@@ -25,13 +41,15 @@ static char *mem_max_addr;   /* largest legal heap address */
 void mem_init(void)
 {
     /* allocate the storage we will use to model the available VM */
-    if ((mem_start_brk = (char *)malloc(MAX_HEAP)) == NULL) {
+    /* (zeroed, so the heap reads as zero until it is first written) */
+    if ((mem_start_brk = (char *)calloc(1, MAX_HEAP)) == NULL) {
 	fprintf(stderr, "mem_init_vm: malloc error\n");
 	exit(1);
     }
 
     mem_max_addr = mem_start_brk + MAX_HEAP;  /* max legal heap address */
     mem_brk = mem_start_brk;                  /* heap is empty initially */
+    mem_peak = 0;
 }
 
 /* 
@@ -39,35 +57,173 @@ void mem_init(void)
  */
 void mem_deinit(void)
 {
+    mem_reset_brk();
     free(mem_start_brk);
+    free(mem_maps);
 }
 
 /*
- * mem_reset_brk - reset the simulated brk pointer to make an empty heap
+ * mem_reset_brk - reset the simulated brk pointer to make an empty heap,
+ *    mappings left over by mem_map are dropped as well
  */
 void mem_reset_brk()
 {
+    while (mem_map_count > 0)
+	mem_unmap(mem_maps[0].lo);
     mem_brk = mem_start_brk;
+    mem_peak = 0;
+    mem_sbrk_count = 0;
 }
 
 /* 
  * mem_sbrk - simple model of the sbrk function. Extends the heap 
- *    by incr bytes and returns the start address of the new area. In
- *    this model, the heap cannot be shrunk.
+ *    by incr bytes and returns the start address of the new area. A
+ *    negative incr shrinks the heap and returns the old brk, as sbrk
+ *    does; the heap cannot shrink below its first byte.
  */
 void *mem_sbrk(int incr) 
 {
     char *old_brk = mem_brk;
 
-    if ( (incr < 0) || ((mem_brk + incr) > mem_max_addr)) {
+    mem_sbrk_count++;
+    if ((incr < 0) && ((mem_brk + incr) < mem_start_brk)) {
+	errno = EINVAL;
+	fprintf(stderr, "ERROR: mem_sbrk failed. Shrunk below the heap start...\n");
+	return (void *)-1;
+    }
+    if ((mem_brk + incr) > mem_max_addr) {
 	errno = ENOMEM;
 	fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
 	return (void *)-1;
     }
     mem_brk += incr;
+    mem_note_peak();
     return (void *)old_brk;
 }
 
+/*
+ * mem_map - model of an anonymous mmap outside the sbrk heap. Maps at
+ *    least size bytes (rounded up to whole pages) and returns the page
+ *    aligned start of the mapping.
+ */
+void *mem_map(size_t size)
+{
+    char *lo;
+
+    size = (size + mem_pagesize() - 1) & ~(mem_pagesize() - 1);
+    if (mem_map_count == mem_map_max) {
+	int new_max = mem_map_max ? 2 * mem_map_max : 16;
+	mem_region_t *new_maps = realloc(mem_maps, new_max * sizeof(mem_region_t));
+
+	if (new_maps == NULL) {
+	    errno = ENOMEM;
+	    fprintf(stderr, "ERROR: mem_map failed. Ran out of memory...\n");
+	    return (void *)-1;
+	}
+	mem_maps = new_maps;
+	mem_map_max = new_max;
+    }
+    lo = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (lo == MAP_FAILED) {
+	fprintf(stderr, "ERROR: mem_map failed. Ran out of memory...\n");
+	return (void *)-1;
+    }
+
+    mem_maps[mem_map_count].lo = lo;
+    mem_maps[mem_map_count].size = size;
+    mem_map_count++;
+    mem_mapped += size;
+    mem_note_peak();
+    return (void *)lo;
+}
+
+/*
+ * mem_unmap - release a mapping made by mem_map, given its start address.
+ *    Returns 0 on success, -1 if lo does not start a mapping.
+ */
+int mem_unmap(void *lo)
+{
+    int i;
+
+    for (i = 0; i < mem_map_count; i++) {
+	if (mem_maps[i].lo == lo) {
+	    munmap(lo, mem_maps[i].size);
+	    mem_mapped -= mem_maps[i].size;
+	    mem_maps[i] = mem_maps[--mem_map_count];
+	    return 0;
+	}
+    }
+    errno = EINVAL;
+    fprintf(stderr, "ERROR: mem_unmap failed. Not a mapping...\n");
+    return -1;
+}
+
+/*
+ * mem_remap - model of mremap with MREMAP_MAYMOVE. Resizes the mapping
+ *    starting at lo to size bytes (rounded up to whole pages), moving it
+ *    if it cannot grow in place; the kernel moves page table entries,
+ *    not bytes. Returns the new start, or (void *)-1 on failure, in
+ *    which case the old mapping is left untouched.
+ */
+void *mem_remap(void *lo, size_t size)
+{
+    char *new_lo;
+    int i;
+
+    size = (size + mem_pagesize() - 1) & ~(mem_pagesize() - 1);
+    for (i = 0; i < mem_map_count; i++)
+	if (mem_maps[i].lo == lo)
+	    break;
+    if (i == mem_map_count) {
+	errno = EINVAL;
+	fprintf(stderr, "ERROR: mem_remap failed. Not a mapping...\n");
+	return (void *)-1;
+    }
+
+    new_lo = mremap(lo, mem_maps[i].size, size, MREMAP_MAYMOVE);
+    if (new_lo == MAP_FAILED) {
+	fprintf(stderr, "ERROR: mem_remap failed. Ran out of memory...\n");
+	return (void *)-1;
+    }
+
+    mem_mapped = mem_mapped - mem_maps[i].size + size;
+    mem_maps[i].lo = new_lo;
+    mem_maps[i].size = size;
+    mem_note_peak();
+    return (void *)new_lo;
+}
+
+/*
+ * mem_is_mapped - returns 1 if the bytes lo..hi lie inside one mapping
+ */
+int mem_is_mapped(void *lo, void *hi)
+{
+    int i;
+
+    for (i = 0; i < mem_map_count; i++)
+	if ((char *)lo >= mem_maps[i].lo && 
+	    (char *)hi < mem_maps[i].lo + mem_maps[i].size)
+	    return 1;
+    return 0;
+}
+
+/*
+ * mem_mapsize() - returns the bytes currently mapped by mem_map
+ */
+size_t mem_mapsize()
+{
+    return mem_mapped;
+}
+
+/*
+ * mem_note_peak - remember the largest heap + mapped size seen
+ */
+static void mem_note_peak(void)
+{
+    if (mem_heapsize() + mem_mapped > mem_peak)
+	mem_peak = mem_heapsize() + mem_mapped;
+}
+
 /*
  * mem_heap_lo - return address of the first heap byte
  */
@@ -92,6 +248,24 @@ size_t mem_heapsize()
     return (size_t)(mem_brk - mem_start_brk);
 }
 
+/*
+ * mem_peak_heapsize() - returns the largest heap size in bytes since
+ *    the last mem_reset_brk, counting the mem_map mappings too
+ */
+size_t mem_peak_heapsize()
+{
+    return mem_peak;
+}
+
+/*
+ * mem_sbrk_calls() - returns the number of mem_sbrk calls since the
+ *    last mem_reset_brk
+ */
+int mem_sbrk_calls()
+{
+    return mem_sbrk_count;
+}
+
 /*
  * mem_pagesize() - returns the page size of the system
  */
@@ -3,9 +3,16 @@
 void mem_init(void);               
 void mem_deinit(void);
 void *mem_sbrk(int incr);
+void *mem_map(size_t size);
+int mem_unmap(void *lo);
+void *mem_remap(void *lo, size_t size);
+int mem_is_mapped(void *lo, void *hi);
+size_t mem_mapsize(void);
 void mem_reset_brk(void); 
 void *mem_heap_lo(void);
 void *mem_heap_hi(void);
 size_t mem_heapsize(void);
+size_t mem_peak_heapsize(void);
+int mem_sbrk_calls(void);
 size_t mem_pagesize(void);
 
@@ -3,9 +3,20 @@
 #include <assert.h>
 #include <unistd.h>
 #include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define MM_X86_COPY                 // [MOD] vector copy loops, picked at run time by the CPU features
+#endif
 
 #include "mm.h"
 #include "memlib.h"
+#include "config.h"
 
 team_t team = {
     ".",
@@ -18,58 +29,362 @@ team_t team = {
 /***** [MOD] FUNCTION CALL *****/
 static void *coalesce(void *curr_ptr);
 static void *extend_heap(size_t size);
-static void *find_first_fit(size_t size);
+static void *take_from_top(size_t alloc_size);
+static void *heap_alloc(size_t alloc_size);
+static void *fit_alloc(size_t alloc_size);
+static void heap_free(void *curr_ptr);
+static size_t block_capacity(void *curr_ptr);
+static void trim_top(void);
+static void *find_fit(size_t size);
+static void *list_fit(int class_idx, size_t size);
 static void place(void *curr_ptr, size_t a_size);
+static int get_class(size_t size);
+static void insert_free_block(void *curr_ptr);
 static void remove_free_block(void *curr_ptr);
+static void *free_block(void *curr_ptr);
+static void shrink_block(void *curr_ptr, size_t block_size, size_t alloc_size);
+static void *headroom_track(void *curr_ptr, size_t need_size);
+static void headroom_forget(void *curr_ptr);
+static void headroom_release(int slot);
+static int headroom_reclaim(void);
+static int span_reclaim(void);
+static int consolidate_fastbins(void);
+static void *alloc_aligned(size_t align, size_t alloc_size);
+static size_t aligned_lead(char *curr_ptr, size_t align);
+static void *slab_malloc(size_t size);
+static void slab_free(void *curr_ptr);
+static void slab_release_top(void);
+static struct slab *page_lookup(void *curr_ptr);
+static void *short_malloc(size_t size);
+static void short_free(struct slab *region, void *curr_ptr);
+static int short_at_top(struct slab *region);
+static void short_release(struct slab *region);
+static void *map_block(size_t size);
+static void copy_init(void);
+static void copy_block(void *dst, const void *src, size_t size);
+#ifndef MM_TLSF
+static void tree_insert(void *curr_ptr);
+static void tree_remove(void *curr_ptr);
+static void *tree_best_fit(size_t size);
+#endif
 
 // skeletal code from CS:APP - diagram 9.43
 /***** DECLARING CONSTANTS *****/
+#undef ALIGNMENT
 #define ALIGNMENT           8 
 #define SIZE4               4       // word and hdr/ftr size (4 bytes)
 #define SIZE8               8       // double word size (8 bytes)
-#define DEFAULTBLOCKSIZE    16      // default block size  
+#define DEFAULTBLOCKSIZE    16      // default block size (a free block needs hdr + 2 links + ftr)
+#define PREV_ALLOC          0x2     // [MOD] header bit: the block physically before this one is allocated
+#define GROWN               0x4     // [MOD] header bit: the block was grown by mm_realloc, it may carry headroom
+#define HEADROOM_SLOTS      16      // [MOD] grown blocks whose headroom can be taken back under pressure
+#define BEST_OF_N           8       // [MOD] fitting blocks looked at by MM_POLICY_BEST_OF_N
+#define FASTBIN_MIN         MM_FASTBIN_MIN  // [MOD] smallest block kept in a fastbin, smaller requests are slab slots
+#define FASTBIN_MAX         (FASTBIN_MIN + (MM_NUM_FASTBINS - 1) * SIZE8)   // [MOD] largest block kept in a fastbin
+#define FASTBIN_LIMIT       (64 * 1024) // [MOD] default cap on the bytes parked in one fastbin
+#define FASTBIN_CONSOLIDATE (64 * 1024) // [MOD] a free that leaves a free block this large merges the fastbins
+#define TRIM_THRESHOLD      (128 * 1024)    // [MOD] a top chunk larger than this is given back with a negative mem_sbrk
+#define TRIM_PAD            (64 * 1024)     // [MOD] bytes of top chunk kept after a trim
+#define COPY_STREAM_DEFAULT (1024 * 1024)   // [MOD] streaming threshold when the cache size is unknown
+#define MMAP_THRESHOLD      (256 * 1024)    // [MOD] requests of at least this many bytes get their own mapping
+#define MAX_REQUEST         (SIZE_MAX - (ALIGNMENT + SIZE4))    // [MOD] larger requests would wrap around in ALIGN(size + SIZE4)
+#define BATCH_MAX_BYTES     (64 * 1024)     // [MOD] mm_malloc_batch carves at most this much from one free block
+#define GROWTH_MIN_CHUNK    (4 * 1024)      // [MOD] default: the heap never grows by less than this
+#define GROWTH_PERCENT      3               // [MOD] default: a chunk never exceeds this percent of the heap
+#define SLAB_SIZE           4096    // [MOD] one slab = one page, page aligned
+#define SLAB_MAX            128     // [MOD] requests up to this size are served from slabs
+#define SLAB_GRAIN          8       // [MOD] slot sizes are multiples of this
+#define NUM_SLAB_CLASSES    (SLAB_MAX / SLAB_GRAIN)
+#define SLAB_MAP_WORDS      (SLAB_SIZE / SLAB_GRAIN / 32)   // [MOD] free slot bitmap words, a multiple of 4 for SSE
+#if FASTBIN_MIN != (SLAB_MAX + SIZE4 + ALIGNMENT) / ALIGNMENT * ALIGNMENT
+#error "the fastbins have to start at the block size of the smallest request above SLAB_MAX"
+#endif
+#define HEAP_PAGES          (MAX_HEAP / SLAB_SIZE + 1)      // [MOD] pages the heap can span
+#define PAGEMAP_LEAF_BITS   6       // [MOD] one page map leaf covers 2^6 heap pages
+#define PAGEMAP_LEAF        (1 << PAGEMAP_LEAF_BITS)
+#define PAGEMAP_ROOT        (HEAP_PAGES / PAGEMAP_LEAF + 1)
+#define DESC_CHUNK          16      // [MOD] slab descriptors carved per metadata block
+#define SLAB_SPAN_MAX       MM_SLAB_SPAN    // [MOD] default: a span of slab pages never exceeds this many pages
+#define SPAN_DIV            2       // [MOD] a new span gets 1/SPAN_DIV of the pages the slabs already hold
+#define SHORT_REGION_SIZE   (16 * 1024)     // [MOD] one region of short-lived blocks, whole pages
+#define SHORT_MAX           (SHORT_REGION_SIZE / 8) // [MOD] larger short-lived requests take the ordinary path
+#define PAGE_MAP_MAX        (ALIGN(SHORT_MAX + SIZE4) - SIZE4)  // [MOD] largest payload of a slab slot or short-lived block
+#ifdef MM_TLSF
+// [MOD] TLSF: 2^FL_SHIFT..2^31 split into FL_COUNT power-of-two ranges of SL_COUNT lists each
+#define SL_LOG2             4
+#define SL_COUNT            (1 << SL_LOG2)
+#define FL_SHIFT            (SL_LOG2 + 3)   // sizes below 2^FL_SHIFT get one list per 8 bytes
+#define FL_COUNT            25
+#define NUM_CLASSES         (FL_COUNT * SL_COUNT)
+#else
+#define TREE_MIN            512     // [MOD] free blocks of at least this size live in the red-black tree
+#define NUM_CLASSES         5       // [MOD] number of segregated free lists (16 bytes ~ TREE_MIN)
+#endif
 
 /***** DECLARING MACRO *****/
 #define ALIGN(size)         (((size) + (ALIGNMENT-1)) & ~0x7) 
 #define MAX(x,y)            ((x) > (y) ? (x) : (y))
+#define MIN(x,y)            ((x) < (y) ? (x) : (y))
 #define PACK(size, alloc)   ((size) | (alloc))
-#define GET(curr_ptr)       (*(size_t *)(curr_ptr))
-#define PUT(curr_ptr,val)   (*(size_t *)(curr_ptr) = (val))
-#define GET_SIZE(curr_ptr)  (GET(curr_ptr) & ~0x1)  // ~0x1 = 11111110 = masks out one LSB, used for memory alignment
+#define GET(curr_ptr)       (*(uint32_t *)(curr_ptr))   // [MOD] headers and footers are 4 bytes on 32 and 64 bit builds
+#define PUT(curr_ptr,val)   (*(uint32_t *)(curr_ptr) = (uint32_t)(val))
+#define GET_SIZE(curr_ptr)  (GET(curr_ptr) & ~0x7)  // ~0x7 = 11111000 = masks out the three flag LSBs, sizes are 8 byte aligned
 #define GET_ALLOC(curr_ptr) (GET(curr_ptr) & 0x1)   // 0x1 = 00000001 = isolates LSB => LSB = 1 means memory is considered alloated 0 otherwise 
+#define GET_PREV_ALLOC(curr_ptr) (GET(curr_ptr) & PREV_ALLOC)   // [MOD] only free blocks have a footer, so ask the header
+#define SET_PREV_ALLOC(curr_ptr)   PUT(curr_ptr, GET(curr_ptr) | PREV_ALLOC)
+#define CLEAR_PREV_ALLOC(curr_ptr) PUT(curr_ptr, GET(curr_ptr) & ~PREV_ALLOC)
+#define GET_GROWN(curr_ptr)     (GET(curr_ptr) & GROWN)         // [MOD] only meaningful on an allocated block
 #define HDRP(curr_ptr)      ((void *)(curr_ptr) - SIZE4)                             // HeaDeR Pointer
-#define FTRP(curr_ptr)      ((void *)(curr_ptr) + GET_SIZE(HDRP(curr_ptr)) - SIZE8)  // FooTeR Pointer
+#define FTRP(curr_ptr)      ((void *)(curr_ptr) + GET_SIZE(HDRP(curr_ptr)) - SIZE8)  // FooTeR Pointer (free blocks only)
 #define NEXT_BLKP(curr_ptr) ((void *)(curr_ptr) + GET_SIZE(HDRP(curr_ptr)))          // NEXT BLocK
-#define PREV_BLKP(curr_ptr) ((void *)(curr_ptr) - GET_SIZE(HDRP(curr_ptr) - SIZE4))  // PREV BLocK
+#define PREV_BLKP(curr_ptr) ((void *)(curr_ptr) - GET_SIZE(HDRP(curr_ptr) - SIZE4))  // PREV BLocK (only if !GET_PREV_ALLOC)
 
-// [MOD] to traverse free list
-#define NEXT_FREE(free_ptr)  (*(void **)(free_ptr))
-#define PREV_FREE(free_ptr)  (*(void **)(free_ptr + SIZE4))
+#ifdef MM_TLSF
+// [MOD] find last / first set bit, the only "search" TLSF ever does
+#define FLS(x)              (31 - __builtin_clz(x))
+#define FFS(x)              (__builtin_ctz(x))
+#endif
+
+// [MOD] to traverse free list (links are read/written through GET_PTR/PUT_PTR only)
+// a link is a 4 byte offset from mem_heap_lo(), 0 = NULL (offset 0 is the alignment padding, never a block),
+// so a 64 bit build keeps the 16 byte minimum block
+#define GET_PTR(p)              (GET(p) ? (char *)mem_heap_lo() + GET(p) : NULL)
+#define PUT_PTR(p, val)         PUT(p, (val) ? (char *)(val) - (char *)mem_heap_lo() : 0)
+#define NEXT_FREE(free_ptr)     GET_PTR(free_ptr)
+#define PREV_FREE(free_ptr)     GET_PTR((void *)(free_ptr) + SIZE4)
+#define SET_NEXT_FREE(free_ptr, val)  PUT_PTR(free_ptr, val)
+#define SET_PREV_FREE(free_ptr, val)  PUT_PTR((void *)(free_ptr) + SIZE4, val)
+#define IS_FASTBIN_SIZE(size)   ((size) >= FASTBIN_MIN && (size) <= FASTBIN_MAX)
+#define FASTBIN_IDX(size)       (((size) - FASTBIN_MIN) / SIZE8)    // [MOD] one fastbin per 8 byte block size
+
+// [MOD] slab lookup: the page map takes any pointer to the descriptor of the slab on its page, or NULL
+#define SLAB_CLASS(size)        (((size) - 1) / SLAB_GRAIN)
+#define PAGE_IDX(curr_ptr)      ((size_t)((char *)(curr_ptr) - heap_page_base) / SLAB_SIZE)
+#define IS_SLAB(curr_ptr)       (page_lookup(curr_ptr) != NULL)
+#define SLAB_OF(curr_ptr)       page_lookup(curr_ptr)
+#define IS_SHORT_REGION(slab)   ((slab)->slot_size == 0)    // [MOD] the descriptor belongs to a short-lived region
+
+// [MOD] mapped blocks: a size 0 allocated header, the mapping length sits in the word before it
+#define MAPPED_HDR              (2 * SIZE8)
+#define IS_MAPPED(curr_ptr)     (GET(HDRP(curr_ptr)) == PACK(0, 1))
+#define MAPPED_SIZE(curr_ptr)   (*(size_t *)((char *)(curr_ptr) - MAPPED_HDR))   // [MOD] a size_t, mappings may exceed 4 GB
+
+// [MOD] slab descriptor, kept out of band in a descriptor block; the slots themselves carry no header
+// a span of slab pages uses the same descriptor: slots = first page, num_slots = pages, free_map[0] = free pages
+typedef struct slab {
+    struct slab *next;                      // partial list of the size class / spans with a free page, or the unused descriptors
+    struct slab *prev;
+    struct slab *span;                      // slab: the span its page was taken from
+    char *slots;                            // the page the slots fill
+    unsigned int slot_size;                 // 0 => a region of short-lived blocks, not a slab
+    unsigned int num_slots;
+    unsigned int used;                      // slots (pages of a span) in use, or live blocks of a region
+    unsigned int bump;                      // region: offset of the next block header
+    unsigned int free_map[SLAB_MAP_WORDS];  // bit set => slot is free
+    struct desc_block *block;               // descriptor block this descriptor was carved from
+} slab_t;
+
+// [MOD] DESC_CHUNK descriptors carved from one heap block, the block is freed once none of them is in use
+typedef struct desc_block {
+    slab_t desc[DESC_CHUNK];
+    unsigned int used;                      // descriptors handed out
+} desc_block_t;
+
+#ifndef MM_TLSF
+// [MOD] red-black tree node of a large free block, stored in its payload
+#define RED                 1
+#define BLACK               0
+#define TREE_LEFT(node)     GET_PTR(node)
+#define TREE_RIGHT(node)    GET_PTR((void *)(node) + SIZE4)
+#define TREE_PARENT(node)   GET_PTR((void *)(node) + (2 * SIZE4))
+#define TREE_COLOR(node)    ((node) ? GET((void *)(node) + (3 * SIZE4)) : BLACK)    // NULL leaves are black
+#define SET_LEFT(node, val)     PUT_PTR(node, val)
+#define SET_RIGHT(node, val)    PUT_PTR((void *)(node) + SIZE4, val)
+#define SET_PARENT(node, val)   PUT_PTR((void *)(node) + (2 * SIZE4), val)
+#define SET_COLOR(node, val)    PUT((void *)(node) + (3 * SIZE4), val)
+// nodes are ordered by (size, address), so equal sizes never collide and ties go to the lower address
+#define TREE_LESS(a, b)     (GET_SIZE(HDRP(a)) < GET_SIZE(HDRP(b)) || \
+                             (GET_SIZE(HDRP(a)) == GET_SIZE(HDRP(b)) && (char *)(a) < (char *)(b)))
+#endif
 
 static char *heap_head_ptr = 0;
-static char *free_list_ptr = 0; // [MOD] to keep track of explicit Doubly Linked List
+static char *top_ptr = 0;           // [MOD] free block right before the epilogue, never on a free list
+static char *zero_ptr = 0;          // [MOD] every byte from here up to the top chunk footer is still zero (mm_calloc)
+static char *dirty_hi = 0;          // [MOD] highest heap end ever reached, kept across mm_init: memlib never clears below it
+static char *carve_zero = 0;        // [MOD] zero_ptr as it was when take_from_top last cut a block (mm_calloc)
+static char *seg_list[NUM_CLASSES]; // [MOD] heads of the segregated explicit Doubly Linked Lists
+static char *rover[NUM_CLASSES];    // [MOD] MM_POLICY_NEXT_FIT: where the next search of each list starts
+static int policy = MM_POLICY_FIRST_FIT;    // [MOD] how the segregated lists are ordered and searched
+static size_t growth_min_chunk = GROWTH_MIN_CHUNK;  // [MOD] smallest heap extension
+static int growth_percent = GROWTH_PERCENT;         // [MOD] largest heap extension in percent of the heap
+static size_t growth_chunk;                 // [MOD] next heap extension, doubles while the heap keeps growing
+#ifdef MM_TLSF
+static unsigned int fl_bitmap;              // [MOD] bit f set => some list of first level f is non-empty
+static unsigned int sl_bitmap[FL_COUNT];    // [MOD] bit s of sl_bitmap[f] set => list (f, s) is non-empty
+#else
+static char *tree_root;                     // [MOD] red-black tree of the free blocks >= TREE_MIN
+#endif
+static char *fastbin[MM_NUM_FASTBINS];          // [MOD] singly linked LIFO bins of freed but not coalesced blocks
+static size_t fastbin_bytes[MM_NUM_FASTBINS];   // [MOD] bytes parked in each fastbin
+static size_t fastbin_peak[MM_NUM_FASTBINS];    // [MOD] high water mark of fastbin_bytes since mm_init
+static size_t realloc_count[MM_NUM_REALLOC_PATHS];  // [MOD] mm_realloc calls per strategy since mm_init
+static size_t realloc_copy_bytes;               // [MOD] payload bytes moved by mm_realloc since mm_init
+static double realloc_copy_ns;                  // [MOD] time spent moving them (only counted while copy_timing is set)
+static int copy_timing = 0;                     // [MOD] time every realloc copy, off so a copy makes no clock calls
+static size_t calloc_bytes;                     // [MOD] bytes asked for through mm_calloc since mm_init
+static size_t calloc_cleared;                   // [MOD] of those, bytes mm_calloc had to memset
+static void (*copy_stream)(char *dst, const char *src, size_t size);   // [MOD] NULL = memcpy only
+static size_t copy_stream_min;                  // [MOD] copies of at least this size stream past the cache
+static int realloc_headroom = MM_REALLOC_HEADROOM;  // [MOD] percent added to a grown block's size when it grows again
+static char *headroom_ptr[HEADROOM_SLOTS];      // [MOD] grown blocks, NULL = empty slot
+static size_t headroom_need[HEADROOM_SLOTS];    // [MOD] block size the last request of that block needed
+static int headroom_next;                       // [MOD] slot evicted next when all are taken
+static size_t headroom_bytes;                   // [MOD] bytes of headroom currently held by grown blocks
+static size_t headroom_peak;                    // [MOD] high water mark of headroom_bytes since mm_init
+static size_t headroom_reclaimed;               // [MOD] headroom bytes given back since mm_init
+static size_t fastbin_limit = FASTBIN_LIMIT;    // [MOD] a bin holding this many bytes frees eagerly again
+static slab_t *slab_partial[NUM_SLAB_CLASSES];  // [MOD] slabs of each class with at least one free slot
+static slab_t **page_map[PAGEMAP_ROOT];         // [MOD] radix tree: heap page -> its slab descriptor, a leaf is hooked in on first use
+static slab_t *page_leaf[PAGEMAP_ROOT][PAGEMAP_LEAF];  // [MOD] storage of the leaves, static so no heap block of them pins the top chunk
+static slab_t *desc_free;                       // [MOD] unused slab descriptors (doubly linked)
+static slab_t *short_region;                    // [MOD] region short-lived blocks are bumped from, NULL = none yet
+static slab_t *span_list;                       // [MOD] spans with at least one free page
+static unsigned int span_used;                  // [MOD] span pages the slabs hold right now
+static unsigned int span_max = SLAB_SPAN_MAX;   // [MOD] largest span, 1 = every slab page is carved on its own
+static char *heap_page_base;                    // [MOD] page the first heap byte lies in
 
 /* 
 ---------------------------------------------
 basic heap structure visualized
 
-    4 bytes        4 bytes               8+ bytes               4 byte          4 byte
+    4 bytes        4 bytes                   12+ bytes                       4 byte
 |--------------|--------------|--------------|--------------|--------------|--------------|
-|   PROLOGUE   |    HEADER    |           PAYLOAD           |    FOOTER    |   EPILOGUE   |
+|   PROLOGUE   |    HEADER    |                  PAYLOAD                   |   EPILOGUE   |
 |--------------|--------------|--------------|--------------|--------------|--------------|
 ^                             ^       
 heap_head_ptr                 curr_ptr 
 
+An allocated block is only a header and its payload. Bit 0 of the header is the
+allocated bit of the block itself, bit 1 (PREV_ALLOC) mirrors the allocated bit of
+the block right before it. Coalescing only needs the previous block's footer when
+that block is free, so only free blocks pay for a footer.
+
 ---------------------------------------------
 free list structure visualized
 
     4 bytes        4 bytes        4 bytes           1+ bytes          4 byte
 |--------------|--------------|--------------|-------------------|--------------|
-|    HEADER    |   PREV_BLK   |   NEXT_BLK   |   TRASH_PAYLOAD   |    FOOTER    |
+|    HEADER    |   NEXT_BLK   |   PREV_BLK   |   TRASH_PAYLOAD   |    FOOTER    |
 |--------------|--------------|--------------|-------------------|--------------|
 
-Besides the free list structure, this application will keep the free block in front of the
-heap (logically, not physically). This produces extra steps in coalescing and realloc.
+Free blocks below TREE_MIN are kept in NUM_CLASSES segregated lists. List k holds
+the blocks whose size lies in [16 * 2^k, 16 * 2^(k+1)). Inside a list the newest free
+block is kept in front (LIFO), so a search starts at the class of the request and
+only walks the lists that can hold it.
+
+Free blocks of TREE_MIN bytes and more are nodes of a red-black tree keyed by
+(size, address) instead, which gives a true best fit in O(log n):
+
+    4 bytes        4 bytes        4 bytes        4 bytes        4 bytes         4+ bytes         4 byte
+|--------------|--------------|--------------|--------------|--------------|--------------|--------------|
+|    HEADER    |     LEFT     |    RIGHT     |    PARENT    |    COLOR     |TRASH_PAYLOAD |    FOOTER    |
+|--------------|--------------|--------------|--------------|--------------|--------------|--------------|
+
+Built with -DMM_TLSF (mdriver-tlsf) the lists are indexed two-level instead:
+the first level is the power of two of the size, the second level splits that
+range into SL_COUNT equal lists. A bitmap per level makes find_fit two
+find-first-set operations, so malloc and free never walk a list.
+
+Freed blocks of FASTBIN_MIN to FASTBIN_MAX bytes, the smallest blocks above the slab
+tier, skip coalescing: they keep their allocated bit and are pushed onto the fastbin
+of their exact size (singly linked through the first payload word). A malloc of that
+size pops them back without touching the free lists, and all fastbins are consolidated
+in one batch only when a request misses the free lists, before the heap would grow.
+
+Requests of at most SLAB_MAX bytes never get a block of their own. They take a slot
+in a slab: a page split into equal slots of one size class. The whole page is slots,
+the descriptor (links, free slot bitmap) lives out of band in a block of DESC_CHUNK
+descriptors, which goes back to the heap once none of them is in use. The page map
+leaves are static, so no metadata is left in the heap that would keep it from shrinking.
+
+|--------------|------|------|------|------|-----|------|--------|-----|--------|
+| SPAN HEADER  | SLOT | SLOT | SLOT | SLOT | ... | SLOT |  PAGE  | ... |  PAGE  |
+|--------------|------|------|------|------|-----|------|--------|-----|--------|
+               ^ page boundary                          ^ next page         |
+                                                                    page_map[root][leaf]
+                                                                            |
+                                                                            v
+                               |--------|--------|--------|--------|-----|--------|
+                               | HEADER | SLAB_T | SLAB_T | SLAB_T | ... | SLAB_T |  descriptor block
+                               |--------|--------|--------|--------|-----|--------|
+
+Slab pages are taken from spans: page-aligned allocated blocks of whole pages that
+keep the small objects in a sub-heap of their own, apart from the ordinary blocks.
+A new span gets half as many pages as the slabs already hold (at least one, at most
+span_max), so the spans grow with the small object population. A slab that
+empties gives its page back to its span, where a slab of any size class picks it up
+again, and a span whose pages are all free goes back to the heap (unless it is the
+only span with free pages). Before the heap grows, the free pages at the end of every
+span are cut off and freed, so a span reserved too early costs no footprint. So freeing every object of one size leaves whole pages
+for the other sizes, and freeing the ordinary blocks leaves runs that no slab page
+breaks up.
+
+The page map is a two-level radix tree over the heap pages: the root is indexed by
+the high bits of the page number, a leaf (an ordinary allocated block, allocated when
+the first slab in its range appears) by the low bits. Leaves and descriptor blocks are
+never freed, the descriptors of emptied slabs are kept for the next slab. mm_free and
+mm_realloc take any pointer to its slab descriptor in two loads, without touching the
+memory in front of the payload; NULL means the pointer is an ordinary block with a header.
+
+---------------------------------------------
+short-lived region visualized
+
+|--------------|-----|------|---------|------|---------|------|-----------------------|
+|    HEADER    | PAD | HDR  | PAYLOAD | HDR  | PAYLOAD | ...  |        unused         |
+|--------------|-----|------|---------|------|---------|------|-----------------------|
+               ^ page boundary                                ^ slots + bump
+
+mm_malloc_hint(size, MM_SHORT_LIVED) keeps request-scoped blocks out of the heap
+the long-lived ones live in. They are bumped one after the other from a page-aligned
+SHORT_REGION_SIZE allocated block, every page of which the page map points at the
+region's descriptor. A block has a header with its size (for mm_realloc) but no
+footer and is never coalesced: mm_free only counts the region's live blocks down.
+Once that count hits zero the whole region is free at once, the current region
+starts bumping from its first byte again and a full, retired one goes back to the
+heap as a single block. Short-lived blocks never sit between long-lived ones, so
+their frees leave one large run instead of holes.
+
+---------------------------------------------
+top chunk visualized
+
+|--------------|---------------------------------------|--------------|--------------|
+|  TOP HEADER  |            never handed out           |  TOP FOOTER  |   EPILOGUE   |
+|--------------|---------------------------------------|--------------|--------------|
+               ^
+               top_ptr
+
+The free space at the end of the heap is the top chunk. It stays off the free lists:
+requests the free lists (and fastbins) cannot serve are cut from its front by bumping
+top_ptr, the heap only ever grows by extending the top, and blocks freed next to it
+melt back into it. Since the top is used last, older holes are reused first.
+Once a free makes the top larger than TRIM_THRESHOLD, everything past TRIM_PAD is
+returned to memlib by shrinking the heap.
+
+---------------------------------------------
+mapped block visualized
+
+    8 bytes          4 bytes        4 bytes                  4080+ bytes
+|----------------|--------------|--------------|-------------------------------------------|
+|     LENGTH     |    UNUSED    |  PACK(0, 1)  |                  PAYLOAD                  |
+|----------------|--------------|--------------|-------------------------------------------|
+^ page boundary                                ^
+                                               curr_ptr
+
+Requests of MMAP_THRESHOLD bytes and more never enter the sbrk heap, they get a
+mapping of their own from mem_map. A size 0 header cannot belong to a heap block
+(only the epilogue has one), so it flags the block as mapped, and the first bytes
+of the mapping keep its length as a size_t (a 32-bit header word would cut off
+mappings of 4 GB and more). mm_free hands the mapping straight back.
 ---------------------------------------------
 */
 
@@ -77,74 +392,477 @@ heap (logically, not physically). This produces extra steps in coalescing and re
 /*
 mm_init visualized
 
-    4 bytes        4 bytes         4 byte         4 byte        4 byte          4 byte           8 byte
-|--------------|--------------|--------------|--------------|--------------|--------------|------------------|
-|   PROLOGUE   |    HEADER    |  PREV & NEXT BLK or PAYLOAD |    FOOTER    |   EPILOGUE   |      EMPTY       |
-|--------------|--------------|--------------|--------------|--------------|--------------|------------------|
-^              ^                     
-heap_head_ptr  free_list_ptr
+    4 bytes        4 bytes        4 bytes        4 bytes
+|--------------|--------------|--------------|--------------|
+|   PADDING    |  PROLOGUE HDR|  PROLOGUE FTR|EPILOGUE (P=1)|
+|--------------|--------------|--------------|--------------|
+               ^              ^
+               heap_head_ptr - SIZE4
+                              heap_head_ptr
 */
 
 /***** ASGN MAIN FUNCTIONS *****/
 int mm_init(void) {
-  // 4 (prologue) + 4 (blk header) + 4 (free header) + 4 (free footer) + 4 (blk footer) + 4 (epilogue) = 24 byte
-  if ((heap_head_ptr = mem_sbrk(16 + DEFAULTBLOCKSIZE)) == (void *) - 1)
+    int i;
+
+  // 4 (padding) + 4 (prologue hdr) + 4 (prologue ftr) + 4 (epilogue) = 16 byte
+  if ((heap_head_ptr = mem_sbrk(4 * SIZE4)) == (void *) - 1)
       return -1; 
 
-    PUT(heap_head_ptr + (0 * SIZE4), PACK(DEFAULTBLOCKSIZE,1));    // Prologue
-    PUT(heap_head_ptr + (1 * SIZE4), PACK(DEFAULTBLOCKSIZE,0));    // Header
+    PUT(heap_head_ptr + (0 * SIZE4), 0);                    // Alignment padding
+    PUT(heap_head_ptr + (1 * SIZE4), PACK(SIZE8,1));        // Prologue header
+    PUT(heap_head_ptr + (2 * SIZE4), PACK(SIZE8,1));        // Prologue footer
+    PUT(heap_head_ptr + (3 * SIZE4), PACK(0,PREV_ALLOC|1)); // Epilogue (prologue before it is allocated)
 
-    PUT(heap_head_ptr + (2 * SIZE4), PACK(0,0));                   // Prev Blk
-    PUT(heap_head_ptr + (3 * SIZE4), PACK(0,0));                   // Next Blk 
-  
-    PUT(heap_head_ptr + (4 * SIZE4), PACK(DEFAULTBLOCKSIZE,0));    // Footer
-    PUT(heap_head_ptr + (5 * SIZE4), PACK(0,1));                   // Eplilogue
+    // move to the prologue payload so PREV_BLKP of the first block lands on it
+    heap_head_ptr += (2 * SIZE4);
+    top_ptr = NULL;
+    // the heap may start out over bytes an earlier run or a trim left behind
+    dirty_hi = MAX(dirty_hi, (char *)mem_heap_hi() + 1);
+    zero_ptr = dirty_hi;
+    growth_chunk = growth_min_chunk;
 
-    // Prologue is for heap, move 4 bytes to point the header
-    free_list_ptr = heap_head_ptr + (SIZE4);
+    for(i = 0; i < NUM_CLASSES; i++)
+        seg_list[i] = rover[i] = NULL;
+#ifdef MM_TLSF
+    fl_bitmap = 0;
+    for(i = 0; i < FL_COUNT; i++)
+        sl_bitmap[i] = 0;
+#else
+    tree_root = NULL;
+#endif
+    for(i = 0; i < MM_NUM_FASTBINS; i++) {
+        fastbin[i] = NULL;
+        fastbin_bytes[i] = 0;
+        fastbin_peak[i] = 0;
+    }
+    for(i = 0; i < MM_NUM_REALLOC_PATHS; i++)
+        realloc_count[i] = 0;
+    for(i = 0; i < HEADROOM_SLOTS; i++)
+        headroom_ptr[i] = NULL;
+    realloc_copy_bytes = headroom_bytes = headroom_peak = headroom_reclaimed = 0;
+    realloc_copy_ns = 0;
+    calloc_bytes = calloc_cleared = 0;
+    copy_init();
+    headroom_next = 0;
+    for(i = 0; i < NUM_SLAB_CLASSES; i++)
+        slab_partial[i] = NULL;
+    // the descriptor blocks of an earlier run went away with the old heap, a leaf is cleared when it is hooked in again
+    memset(page_map, 0, sizeof(page_map));
+    desc_free = short_region = span_list = NULL;
+    span_used = 0;
+    heap_page_base = (char *)((uintptr_t)mem_heap_lo() & ~(uintptr_t)(SLAB_SIZE - 1));
 
     return 0;
 }
 
 void *mm_malloc(size_t curr_size) {
-    // base case
-    if(curr_size == 0)
+    // base case (a size whose block size wraps around can never be served)
+    if(curr_size == 0 || curr_size > MAX_REQUEST)
         return NULL;
 
-    // minimum size = 16 bytes
-    size_t alloc_size = MAX(ALIGN(curr_size) + SIZE8, DEFAULTBLOCKSIZE);
-    size_t extend_size;
+    // minimum size = 16 bytes, an allocated block carries a header only
+    size_t alloc_size = MAX(ALIGN(curr_size + SIZE4), DEFAULTBLOCKSIZE);
     char *curr_ptr;
     
-    // search free list to fit the block
-    if((curr_ptr = find_first_fit(alloc_size))) {
+    // huge objects get their own mapping, outside the heap
+    if(alloc_size >= MMAP_THRESHOLD)
+        return map_block(curr_size);
+
+    // small objects go to a slab slot
+    if(curr_size <= SLAB_MAX && (curr_ptr = slab_malloc(curr_size)))
+        return curr_ptr;
+
+    // exact size hit in a fastbin, the block is still marked allocated
+    if(IS_FASTBIN_SIZE(alloc_size) && (curr_ptr = fastbin[FASTBIN_IDX(alloc_size)])) {
+        fastbin[FASTBIN_IDX(alloc_size)] = NEXT_FREE(curr_ptr);
+        fastbin_bytes[FASTBIN_IDX(alloc_size)] -= alloc_size;
+        return curr_ptr;
+    }
+
+    return heap_alloc(alloc_size);
+}
+
+// [MOD] n blocks of one size; ordinary blocks are carved from one free block or heap extension per group, returns how many were allocated
+size_t mm_malloc_batch(size_t size, size_t n, void **out) {
+    size_t alloc_size = MAX(ALIGN(size + SIZE4), DEFAULTBLOCKSIZE);
+    size_t block_size, group, done = 0, i;
+    size_t prev_alloc;
+    char *curr_ptr;
+
+    if(size == 0 || size > MAX_REQUEST)
+        return 0;
+
+    // slots and mappings do not get cheaper in a group
+    if(size <= SLAB_MAX || alloc_size >= MMAP_THRESHOLD) {
+        while(done < n && (out[done] = mm_malloc(size)) != NULL)
+            done++;
+        return done;
+    }
+
+    // exact size hits in the fastbin first, they cost nothing to hand out
+    while(done < n && IS_FASTBIN_SIZE(alloc_size) && (curr_ptr = fastbin[FASTBIN_IDX(alloc_size)])) {
+        fastbin[FASTBIN_IDX(alloc_size)] = NEXT_FREE(curr_ptr);
+        fastbin_bytes[FASTBIN_IDX(alloc_size)] -= alloc_size;
+        out[done++] = curr_ptr;
+    }
+
+    // one search and one place per group, then the group block is cut into headers
+    while(done < n) {
+        group = MIN(n - done, MAX(BATCH_MAX_BYTES / alloc_size, 1));
+
+        // no free block holds the group: fill the holes one by one, the rest comes from the top in one piece
+        if((curr_ptr = fit_alloc(group * alloc_size)) == NULL) {
+            while(group > 0 && (curr_ptr = fit_alloc(alloc_size)) != NULL) {
+                out[done++] = curr_ptr;
+                group--;
+            }
+            if(group == 0)
+                continue;
+            if((curr_ptr = heap_alloc(group * alloc_size)) == NULL)
+                break;
+        }
+
+        // the last block keeps the remainder place did not split off
+        block_size = GET_SIZE(HDRP(curr_ptr));
+        prev_alloc = GET_PREV_ALLOC(HDRP(curr_ptr));
+        for(i = 0; i < group; i++) {
+            size_t curr_size = (i == group - 1) ? block_size - i * alloc_size : alloc_size;
+
+            PUT(HDRP(curr_ptr), PACK(curr_size, (i ? PREV_ALLOC : prev_alloc) | 1));
+            out[done++] = curr_ptr;
+            curr_ptr += curr_size;
+        }
+    }
+
+    return done;
+}
+
+// [MOD] address order for mm_free_batch
+static int ptr_cmp(const void *a, const void *b) {
+    char *x = *(char * const *)a;
+    char *y = *(char * const *)b;
+
+    return (x > y) - (x < y);
+}
+
+// [MOD] free n blocks at once: ptrs is sorted by address and every run of adjacent blocks is freed and coalesced as one
+void mm_free_batch(void **ptrs, size_t n) {
+    size_t run_size, i, j;
+    char *curr_ptr;
+
+    qsort(ptrs, n, sizeof(void *), ptr_cmp);
+
+    for(i = 0; i < n; i = j) {
+        curr_ptr = ptrs[i];
+        j = i + 1;
+        if(SLAB_OF(curr_ptr) || IS_MAPPED(curr_ptr)) {
+            mm_free(curr_ptr);
+            continue;
+        }
+
+        // a slab page right after a block starts with a slot, so the neighbour is checked too
+        run_size = GET_SIZE(HDRP(curr_ptr));
+        while(j < n && (char *)ptrs[j] == curr_ptr + run_size && !SLAB_OF(ptrs[j])) {
+            if(GET_GROWN(HDRP(ptrs[j])))
+                headroom_forget(ptrs[j]);
+            run_size += GET_SIZE(HDRP(ptrs[j]));
+            j++;
+        }
+
+        // a block without neighbours in the batch takes the usual path, fastbins included
+        if(j == i + 1) {
+            mm_free(curr_ptr);
+            continue;
+        }
+        if(GET_GROWN(HDRP(curr_ptr)))
+            headroom_forget(curr_ptr);
+        PUT(HDRP(curr_ptr), PACK(run_size, GET_PREV_ALLOC(HDRP(curr_ptr)) | 1));
+        free_block(curr_ptr);
+    }
+}
+
+// [MOD] an ordinary heap block of alloc_size from the free lists, NULL if none fits
+static void *fit_alloc(size_t alloc_size) {
+    char *curr_ptr;
+
+    // search the segregated free lists to fit the block, merge the fastbins once on a miss
+    if((curr_ptr = find_fit(alloc_size)) || (consolidate_fastbins() && (curr_ptr = find_fit(alloc_size)))) {
+        place(curr_ptr, alloc_size);
+        return curr_ptr;
+    }
+
+    return NULL;
+}
+
+// [MOD] an ordinary heap block of alloc_size: free lists, fastbins merged, reclaimed memory, then the top chunk
+static void *heap_alloc(size_t alloc_size) {
+    char *curr_ptr;
+
+    if((curr_ptr = fit_alloc(alloc_size)) != NULL)
+        return curr_ptr;
+
+    // the heap would have to grow -> take back the realloc headroom and the unused span pages first
+    if((top_ptr == NULL || GET_SIZE(HDRP(top_ptr)) < alloc_size) && (headroom_reclaim() | span_reclaim())
+            && (curr_ptr = find_fit(alloc_size))) {
         place(curr_ptr, alloc_size);
         return curr_ptr;
     }
 
-    // if free list cannot allocate, get more memory and place block
-    extend_size = MAX(alloc_size, DEFAULTBLOCKSIZE);
-    if ((curr_ptr = extend_heap(extend_size / SIZE4)) == NULL)
+    // if free list cannot allocate, bump the top chunk (growing the heap if it is too small)
+    return take_from_top(alloc_size);
+}
+
+// [MOD] small blocks are parked in their fastbin, everything else is freed and coalesced right away
+void mm_free(void *curr_ptr) { 
+    slab_t *slab;
+
+    if((slab = SLAB_OF(curr_ptr)) != NULL) {
+        if(IS_SHORT_REGION(slab))
+            short_free(slab, curr_ptr);
+        else
+            slab_free(curr_ptr);
+        return;
+    }
+
+    heap_free(curr_ptr);
+}
+
+// [MOD] free with the size the block was asked for; above PAGE_MAP_MAX the block cannot be a slot or a
+// short-lived block, so the page map walk (two dependent loads) is skipped
+void mm_free_sized(void *curr_ptr, size_t size) {
+    slab_t *slab;
+
+#ifdef MM_DEBUG
+    if(size == 0 || size > block_capacity(curr_ptr)) {
+        fprintf(stderr, "mm_free_sized: %p freed with size %lu, its block holds %lu bytes\n",
+                curr_ptr, (unsigned long)size, (unsigned long)block_capacity(curr_ptr));
+        abort();
+    }
+#endif
+
+    if(size <= PAGE_MAP_MAX && (slab = SLAB_OF(curr_ptr)) != NULL) {
+        if(IS_SHORT_REGION(slab))
+            short_free(slab, curr_ptr);
+        else
+            slab_free(curr_ptr);
+        return;
+    }
+
+    heap_free(curr_ptr);
+}
+
+// [MOD] payload bytes the block behind a pointer from mm_malloc can hold
+static size_t block_capacity(void *curr_ptr) {
+    slab_t *slab;
+
+    if((slab = SLAB_OF(curr_ptr)) != NULL && !IS_SHORT_REGION(slab))
+        return slab->slot_size;
+    if(IS_MAPPED(curr_ptr))
+        return MAPPED_SIZE(curr_ptr) - MAPPED_HDR;
+    return GET_SIZE(HDRP(curr_ptr)) - SIZE4;
+}
+
+// [MOD] bytes the caller may use, the slack place() left unsplit included
+// a grown block leaves the headroom slots: once the caller owns the headroom it can no longer be taken back,
+// but it stays marked grown so its next mm_realloc adds headroom again
+size_t mm_usable_size(void *curr_ptr) {
+    if(curr_ptr == NULL)
+        return 0;
+    if(SLAB_OF(curr_ptr) == NULL && !IS_MAPPED(curr_ptr) && GET_GROWN(HDRP(curr_ptr))) {
+        headroom_forget(curr_ptr);
+        PUT(HDRP(curr_ptr), GET(HDRP(curr_ptr)) | GROWN);
+    }
+
+    return block_capacity(curr_ptr);
+}
+
+// [MOD] malloc that tells the caller how much it got, *actual >= size (a new block is never grown)
+void *mm_malloc_at_least(size_t size, size_t *actual) {
+    char *curr_ptr = mm_malloc(size);
+
+    *actual = curr_ptr ? block_capacity(curr_ptr) : 0;
+    return curr_ptr;
+}
+
+// [MOD] free a block that is not in a slab or region: mappings are unmapped, small blocks parked in their fastbin
+static void heap_free(void *curr_ptr) {
+    size_t size;
+    int bin;
+
+    if(IS_MAPPED(curr_ptr)) {
+        mem_unmap((char *)curr_ptr - MAPPED_HDR);
+        return;
+    }
+
+    if(GET_GROWN(HDRP(curr_ptr)))
+        headroom_forget(curr_ptr);
+
+    // a block right below the top chunk merges into it instead, parked there it would keep the heap from shrinking
+    size = GET_SIZE(HDRP(curr_ptr));
+    if(IS_FASTBIN_SIZE(size) && (char *)NEXT_BLKP(curr_ptr) != top_ptr && fastbin_bytes[bin = FASTBIN_IDX(size)] + size <= fastbin_limit) {
+        SET_NEXT_FREE(curr_ptr, fastbin[bin]);
+        fastbin[bin] = curr_ptr;
+        fastbin_bytes[bin] += size;
+        fastbin_peak[bin] = MAX(fastbin_peak[bin], fastbin_bytes[bin]);
+        return;
+    }
+
+    // a large free block (or a top chunk that grew) is a sign the heap is emptying, the parked blocks are merged then
+    if(GET_SIZE(HDRP(free_block(curr_ptr))) >= FASTBIN_CONSOLIDATE)
+        consolidate_fastbins();
+}
+
+// [MOD] zeroed allocation, the memset skips what is known to be zero: untouched top chunk bytes and new mappings
+void *mm_calloc(size_t nmemb, size_t size) {
+    char *zero_lo;
+    char *curr_ptr;
+    size_t bytes, dirty_size;
+
+    if(size != 0 && nmemb > (size_t)-1 / size)
         return NULL;
+    bytes = nmemb * size;
+    carve_zero = NULL;
+    if((curr_ptr = mm_malloc(bytes)) == NULL)
+        return NULL;
+    // read after the allocation: a heap extension inside mm_malloc may have moved zero_ptr
+    // (a block carved from above carve_zero was never written, anything else is dirty)
+    zero_lo = carve_zero ? carve_zero : curr_ptr + bytes;
 
-    // Place the newly allocated block
-    place(curr_ptr, alloc_size);
+    calloc_bytes += bytes;
+    // a mapping lies outside the heap and comes zeroed from the kernel
+    if(curr_ptr < (char *)mem_heap_lo() || curr_ptr > (char *)mem_heap_hi())
+        return curr_ptr;
+    // recycled blocks, slab slots and fastbin hits all lie below zero_lo
+    if(curr_ptr < zero_lo) {
+        dirty_size = MIN(bytes, (size_t)(zero_lo - curr_ptr));
+        memset(curr_ptr, 0, dirty_size);
+        calloc_cleared += dirty_size;
+    }
 
     return curr_ptr;
 }
 
-// CS:APP - diagram 9.46
-void mm_free(void *curr_ptr) { 
-    size_t size = GET_SIZE(HDRP(curr_ptr));
+// [MOD] payload aligned to align (a power of two): a slab slot when its class lines up, else carved out of a free block
+void *mm_memalign(size_t align, size_t size) {
+    size_t slot_size;
+    char *curr_ptr;
 
-    PUT(HDRP(curr_ptr), PACK(size,0));
-    PUT(FTRP(curr_ptr), PACK(size,0));
+    if(align == 0 || (align & (align - 1)))
+        return NULL;
+    if(align <= ALIGNMENT)
+        return mm_malloc(size);
+    // alloc_aligned looks for room for the block, align and a leading fragment
+    if(size == 0 || size > MAX_REQUEST - align - DEFAULTBLOCKSIZE)
+        return NULL;
+
+    // slabs start on a page and a class that is a multiple of align keeps every slot on a multiple of align
+    if(align <= SLAB_MAX && (slot_size = (size + align - 1) & ~(align - 1)) <= SLAB_MAX
+            && (curr_ptr = slab_malloc(slot_size)))
+        return curr_ptr;
+
+    // the leading fragment goes back to the free lists in alloc_aligned, the trailing one in place
+    return alloc_aligned(align, MAX(ALIGN(size + SIZE4), DEFAULTBLOCKSIZE));
+}
+
+// [MOD] C11 aligned_alloc: like mm_memalign, the size has to be a multiple of align
+void *mm_aligned_alloc(size_t align, size_t size) {
+    if(align == 0 || size % align)
+        return NULL;
+
+    return mm_memalign(align, size);
+}
+
+// [MOD] malloc with a lifetime hint, short-lived blocks go to a region of their own
+void *mm_malloc_hint(size_t size, int hint) {
+    char *curr_ptr;
+
+    if(hint == MM_SHORT_LIVED && size > 0 && size <= SHORT_MAX && (curr_ptr = short_malloc(size)))
+        return curr_ptr;
+
+    // long-lived blocks are what the heap is laid out for
+    return mm_malloc(size);
+}
+
+// [MOD] cap on the bytes a single fastbin may hold, 0 disables the fastbins
+void mm_set_fastbin_limit(size_t bytes) {
+    consolidate_fastbins();
+    fastbin_limit = bytes;
+}
+
+// [MOD] turn the timing of realloc copies (realloc_copy_ns) on or off
+void mm_set_copy_timing(int on) {
+    copy_timing = on;
+}
+
+// [MOD] snapshot of the allocator counters for the driver
+void mm_get_stats(mm_stats_t *stats) {
+    int i;
+
+    for(i = 0; i < MM_NUM_FASTBINS; i++) {
+        stats->fastbin_bytes[i] = fastbin_bytes[i];
+        stats->fastbin_peak[i] = fastbin_peak[i];
+    }
+    for(i = 0; i < MM_NUM_REALLOC_PATHS; i++)
+        stats->realloc_count[i] = realloc_count[i];
+    stats->realloc_copy_bytes = realloc_copy_bytes;
+    stats->realloc_copy_ns = realloc_copy_ns;
+    stats->calloc_bytes = calloc_bytes;
+    stats->calloc_cleared = calloc_cleared;
+    stats->headroom_bytes = headroom_bytes;
+    stats->headroom_peak = headroom_peak;
+    stats->headroom_reclaimed = headroom_reclaimed;
+}
+
+// [MOD] switch the placement policy of the segregated lists, the listed blocks are re-inserted in the new order
+int mm_set_policy(int new_policy) {
+    char *chain = NULL;
+    char *curr_ptr;
+    int i;
+
+    if(new_policy < 0 || new_policy >= MM_NUM_POLICIES)
+        return -1;
+
+    // only the lists depend on the policy, the tree stays as it is
+    for(i = 0; i < NUM_CLASSES; i++) {
+        while((curr_ptr = seg_list[i]) != NULL) {
+            remove_free_block(curr_ptr);
+            SET_NEXT_FREE(curr_ptr, chain);
+            chain = curr_ptr;
+        }
+        rover[i] = NULL;
+    }
+
+    policy = new_policy;
+    while((curr_ptr = chain) != NULL) {
+        chain = NEXT_FREE(curr_ptr);
+        insert_free_block(curr_ptr);
+    }
+
+    return 0;
+}
+
+// [MOD] largest span of slab pages, 1 carves every slab page on its own
+void mm_set_slab_span(int pages) {
+    span_max = MIN(MAX(pages, 1), 32);
+}
 
-    coalesce(curr_ptr);
+// [MOD] heap growth policy: extensions of at least min_chunk bytes, at most percent of the heap, 0 and 0 = exact
+void mm_set_heap_growth(size_t min_chunk, int percent) {
+    growth_min_chunk = growth_chunk = ALIGN(min_chunk);
+    growth_percent = percent;
+}
+
+// [MOD] percent of headroom given to a block that keeps growing, 0 turns the headroom off
+void mm_set_realloc_headroom(int percent) {
+    headroom_reclaim();
+    realloc_headroom = percent;
 }
 
 // [MOD] because freed block will be moved to the front (not physically, only logically), extra procedures are required
 void *mm_realloc(void *curr_ptr, size_t size) {
+    slab_t *slab;
+
     if (curr_ptr == NULL)
         return mm_malloc(size);
 
@@ -152,68 +870,269 @@ void *mm_realloc(void *curr_ptr, size_t size) {
         mm_free(curr_ptr);
         return NULL;
     }
-    
-    size_t alloc_size = MAX(ALIGN(size) + SIZE8, DEFAULTBLOCKSIZE);
-    size_t curr_size = GET_SIZE(HDRP(curr_ptr));
 
-    void *next_ptr;
-    char *next_blk = HDRP(NEXT_BLKP(curr_ptr));
-    size_t new_size = curr_size + GET_SIZE(next_blk);
+    // like malloc, a size that wraps around fails and the block stays as it is
+    if(size > MAX_REQUEST)
+        return NULL;
 
-    // base case
-    if(alloc_size == curr_size)
-        return curr_ptr;
+    // a short-lived block grows in place only as the newest block of its region, otherwise it moves to another short-lived block
+    if((slab = SLAB_OF(curr_ptr)) != NULL && IS_SHORT_REGION(slab)) {
+        size_t block_size = GET_SIZE(HDRP(curr_ptr));
+        size_t new_size = ALIGN(size + SIZE4);
+        void *new_ptr;
 
-    // size is less than the curr payload
-    if(alloc_size <= curr_size) {
-        if(alloc_size > DEFAULTBLOCKSIZE && (curr_size - alloc_size) > DEFAULTBLOCKSIZE) {  
-            PUT(HDRP(curr_ptr), PACK(alloc_size, 1));
-            PUT(FTRP(curr_ptr), PACK(alloc_size, 1));
-            next_ptr = NEXT_BLKP(curr_ptr);
-            PUT(HDRP(next_ptr), PACK(curr_size - alloc_size, 1));
-            PUT(FTRP(next_ptr), PACK(curr_size - alloc_size, 1));
-            mm_free(next_ptr);
+        if(new_size <= block_size) {
+            realloc_count[MM_REALLOC_IN_PLACE]++;
+            return curr_ptr;
+        }
+        if((char *)curr_ptr - SIZE4 + block_size == slab->slots + slab->bump
+                && slab->bump - block_size + new_size <= SHORT_REGION_SIZE
+                && new_size <= PAGE_MAP_MAX + SIZE4) {
+            slab->bump += new_size - block_size;
+            PUT(HDRP(curr_ptr), PACK(new_size, 1));
+            realloc_count[MM_REALLOC_TOP]++;
+            return curr_ptr;
+        }
+        if((new_ptr = mm_malloc_hint(size, MM_SHORT_LIVED)) == NULL)
+            return NULL;
+        copy_block(new_ptr, curr_ptr, block_size - SIZE4);
+        short_free(slab, curr_ptr);
+        realloc_count[MM_REALLOC_COPY]++;
+        return new_ptr;
+    }
+
+    // a slot cannot grow, move the object out of it once it no longer fits
+    if(slab != NULL) {
+        size_t slot_size = slab->slot_size;
+        void *new_ptr;
 
+        if(size <= slot_size) {
+            realloc_count[MM_REALLOC_IN_PLACE]++;
             return curr_ptr;
         }
+        if((new_ptr = mm_malloc(size)) == NULL)
+            return NULL;
+        copy_block(new_ptr, curr_ptr, slot_size);
+        slab_free(curr_ptr);
+        realloc_count[MM_REALLOC_COPY]++;
+        return new_ptr;
+    }
 
-        next_ptr = mm_malloc(alloc_size);
-        memcpy(next_ptr, curr_ptr, alloc_size);
+    // a mapping is resized by remapping its pages, only if that fails the bytes are copied
+    if(IS_MAPPED(curr_ptr)) {
+        size_t map_size = MAPPED_SIZE(curr_ptr) - MAPPED_HDR;
+        size_t new_map_size = (ALIGN(size + MAPPED_HDR) + mem_pagesize() - 1) & ~(mem_pagesize() - 1);
+        char *new_ptr;
+
+        // rounding up to whole pages may wrap around as well
+        if(new_map_size < size)
+            return NULL;
+        // a request in the same pages keeps the mapping as it is
+        if(new_map_size == MAPPED_SIZE(curr_ptr)) {
+            realloc_count[MM_REALLOC_IN_PLACE]++;
+            return curr_ptr;
+        }
+        if((new_ptr = mem_remap((char *)curr_ptr - MAPPED_HDR, new_map_size)) != (void *)-1) {
+            new_ptr += MAPPED_HDR;
+            MAPPED_SIZE(new_ptr) = new_map_size;
+            realloc_count[MM_REALLOC_REMAP]++;
+            return new_ptr;
+        }
+        if(size <= map_size) {
+            realloc_count[MM_REALLOC_IN_PLACE]++;
+            return curr_ptr;
+        }
+        if((new_ptr = mm_malloc(size)) == NULL)
+            return NULL;
+        copy_block(new_ptr, curr_ptr, map_size);
         mm_free(curr_ptr);
+        realloc_count[MM_REALLOC_COPY]++;
+        return new_ptr;
+    }
+
+    size_t alloc_size = MAX(ALIGN(size + SIZE4), DEFAULTBLOCKSIZE);
+    size_t curr_size = GET_SIZE(HDRP(curr_ptr));
+    size_t prev_alloc = GET_PREV_ALLOC(HDRP(curr_ptr));
+
+    // a block that grows again gets headroom on top of the request, so the next few reallocs stay in place
+    size_t want_size = alloc_size;
+    if(GET_GROWN(HDRP(curr_ptr))) {
+        headroom_forget(curr_ptr);
+        want_size = ALIGN(alloc_size + alloc_size * realloc_headroom / 100);
+    }
+
+    void *next_ptr;
+    char *next_blk = HDRP(NEXT_BLKP(curr_ptr));
+    size_t new_size = curr_size + GET_SIZE(next_blk);
 
-        return next_ptr;
+    // size is less than or equal to the curr payload
+    if(alloc_size <= curr_size) {
+        // a tail too small to split stays with the block, the payload does not have to move
+        shrink_block(curr_ptr, curr_size, MIN(curr_size, want_size));
+        realloc_count[MM_REALLOC_IN_PLACE]++;
+        return want_size > alloc_size ? headroom_track(curr_ptr, alloc_size) : curr_ptr;
     // size is greater than the curr payload
     } else {
+        // next block is the top chunk or the epilogue -> extend the heap if short, the block becomes the top's front
+        if(NEXT_BLKP(curr_ptr) == top_ptr || GET_SIZE(next_blk) == 0) {
+            if(new_size < alloc_size && extend_heap((alloc_size - new_size) / SIZE4) == NULL)
+                return NULL;
+            new_size = curr_size + GET_SIZE(HDRP(top_ptr));
+            PUT(HDRP(curr_ptr), PACK(new_size, prev_alloc));
+            top_ptr = curr_ptr;
+            realloc_count[MM_REALLOC_TOP]++;
+            // no headroom here, growing at the top never copies
+            return headroom_track(take_from_top(alloc_size), alloc_size);
+        }
         // next block is free and is able to fit -> merge block to the required size
         if(!GET_ALLOC(next_blk) && new_size >= alloc_size ) {
             remove_free_block(NEXT_BLKP(curr_ptr));
-            PUT(HDRP(curr_ptr), PACK(alloc_size, 1));
-            PUT(FTRP(curr_ptr), PACK(alloc_size, 1));
-            next_ptr = NEXT_BLKP(curr_ptr);
-            PUT(HDRP(next_ptr), PACK(new_size - alloc_size, 1));
-            PUT(FTRP(next_ptr), PACK(new_size - alloc_size, 1));
-            mm_free(next_ptr);
+            PUT(HDRP(curr_ptr), PACK(new_size, prev_alloc|1));
+            shrink_block(curr_ptr, new_size, MIN(new_size, want_size));
+            realloc_count[MM_REALLOC_NEXT]++;
+            return headroom_track(curr_ptr, alloc_size);
+        }
+        // prev block is free and prev + curr (+ free next) is able to fit -> merge backwards, slide the payload down
+        // (a free block always has an allocated block before it, so the merged block keeps PREV_ALLOC)
+        if(!prev_alloc) {
+            next_ptr = PREV_BLKP(curr_ptr);
+            new_size = GET_SIZE(HDRP(next_ptr)) + (GET_ALLOC(next_blk) ? curr_size : new_size);
 
-            return curr_ptr;
-        }  
-        // not able to fit -> allocate a new block and free the current block
-        next_ptr = mm_malloc(alloc_size); 
-        memcpy(next_ptr, curr_ptr, curr_size);
+            if(new_size >= alloc_size) {
+                remove_free_block(next_ptr);
+                if(!GET_ALLOC(next_blk))
+                    remove_free_block(NEXT_BLKP(curr_ptr));
+                copy_block(next_ptr, curr_ptr, curr_size - SIZE4);
+                PUT(HDRP(next_ptr), PACK(new_size, PREV_ALLOC|1));
+                shrink_block(next_ptr, new_size, MIN(new_size, want_size));
+                realloc_count[MM_REALLOC_PREV]++;
+                return headroom_track(next_ptr, alloc_size);
+            }
+        }
+        // not able to fit -> move the block to a free block (or the top chunk) and free the current block
+        // (asking for alloc_size as payload leaves a header's worth of slack for the next growth step)
+        // a huge block moves into a mapping of its own instead
+        if(alloc_size >= MMAP_THRESHOLD)
+            next_ptr = map_block(size);
+        else
+            next_ptr = heap_alloc(MAX(ALIGN(want_size + SIZE4), DEFAULTBLOCKSIZE));
+        if(next_ptr == NULL)
+            return NULL;
+        copy_block(next_ptr, curr_ptr, curr_size - SIZE4);
         mm_free(curr_ptr);
-        return next_ptr;
+        realloc_count[MM_REALLOC_COPY]++;
+        return IS_MAPPED(next_ptr) ? next_ptr : headroom_track(next_ptr, alloc_size);
     }
 
 }
 
 /***** MAIN ASSISTING FUNCTIONS *****/
 
+// CS:APP - diagram 9.46
+// [MOD] mark an allocated block free and coalesce it (mm_free without the fastbins), returns the merged free block
+static void *free_block(void *curr_ptr) {
+    size_t size = GET_SIZE(HDRP(curr_ptr));
+
+    PUT(HDRP(curr_ptr), PACK(size, GET_PREV_ALLOC(HDRP(curr_ptr))));
+    PUT(FTRP(curr_ptr), PACK(size,0));
+    CLEAR_PREV_ALLOC(HDRP(NEXT_BLKP(curr_ptr)));
+
+    // [MOD] an empty slab page kept for reuse right below the grown top would keep trim_top from getting past it
+    if((curr_ptr = coalesce(curr_ptr)) == top_ptr) {
+        slab_release_top();
+        if(GET_SIZE(HDRP(top_ptr)) > TRIM_THRESHOLD)
+            trim_top();
+        return top_ptr;
+    }
+
+    return curr_ptr;
+}
+
+// [MOD] bytes from curr_ptr to the first align boundary that leaves room for a leading free block
+static size_t aligned_lead(char *curr_ptr, size_t align) {
+    size_t lead_size = (align - ((uintptr_t)curr_ptr & (align - 1))) & (align - 1);
+
+    if(lead_size != 0 && lead_size < DEFAULTBLOCKSIZE)
+        lead_size += align;
+    return lead_size;
+}
+
+// [MOD] allocate a block whose payload starts on an align boundary, the leading fragment goes back as a free block
+static void *alloc_aligned(size_t align, size_t alloc_size) {
+    // enough for the block, a worst case misalignment and a leading fragment of at least a minimum block
+    size_t search_size = alloc_size + align + DEFAULTBLOCKSIZE;
+    size_t free_size, lead_size;
+    char *curr_ptr, *aligned_ptr;
+    int from_top = 0;
+
+    // a fit for the plain size often lines up already, e.g. a freed block of an earlier aligned request
+    if((curr_ptr = find_fit(alloc_size)) && aligned_lead(curr_ptr, align) + alloc_size <= GET_SIZE(HDRP(curr_ptr)))
+        ;
+    else if(!(curr_ptr = find_fit(search_size)) && !(consolidate_fastbins() && (curr_ptr = find_fit(search_size)))) {
+        // carve from the top chunk, it only has to cover the misalignment plus the block
+        if(top_ptr == NULL && extend_heap(DEFAULTBLOCKSIZE / SIZE4) == NULL)
+            return NULL;
+        curr_ptr = top_ptr;
+        from_top = 1;
+    }
+
+    lead_size = aligned_lead(curr_ptr, align);
+    aligned_ptr = curr_ptr + lead_size;
+
+    if(from_top && GET_SIZE(HDRP(top_ptr)) < lead_size + alloc_size &&
+       extend_heap((lead_size + alloc_size - GET_SIZE(HDRP(top_ptr))) / SIZE4) == NULL)
+        return NULL;
+
+    // split [curr_ptr, aligned_ptr) off as its own free block
+    if(lead_size != 0) {
+        free_size = GET_SIZE(HDRP(curr_ptr));
+        if(!from_top)
+            remove_free_block(curr_ptr);
+
+        PUT(HDRP(curr_ptr), PACK(lead_size, GET_PREV_ALLOC(HDRP(curr_ptr))));
+        PUT(FTRP(curr_ptr), PACK(lead_size, 0));
+        insert_free_block(curr_ptr);
+
+        PUT(HDRP(aligned_ptr), PACK(free_size - lead_size, 0));
+        PUT(FTRP(aligned_ptr), PACK(free_size - lead_size, 0));
+        if(from_top) {
+            top_ptr = aligned_ptr;
+            zero_ptr = MAX(zero_ptr, aligned_ptr);  // the fragment holds links now
+        } else
+            insert_free_block(aligned_ptr);
+    }
+
+    if(from_top)
+        return take_from_top(alloc_size);
+    place(aligned_ptr, alloc_size);
+    return aligned_ptr;
+}
+
+// [MOD] free every block parked in the fastbins, returns 0 if they were all empty
+static int consolidate_fastbins(void) {
+    int i, merged = 0;
+    char *curr_ptr;
+
+    for(i = 0; i < MM_NUM_FASTBINS; i++) {
+        while((curr_ptr = fastbin[i])) {
+            fastbin[i] = NEXT_FREE(curr_ptr);
+            free_block(curr_ptr);
+            merged = 1;
+        }
+        fastbin_bytes[i] = 0;
+    }
+
+    return merged;
+}
+
 // skeletal code from CS:APP - diagram 9.46
 // [MOD] function to merge unused space
 static void *coalesce(void *curr_ptr) {
     // determining the current allocation state of prev and next block
-    size_t prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(curr_ptr))) || PREV_BLKP(curr_ptr) == curr_ptr;
-    size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(curr_ptr)));
+    size_t prev_alloc = GET_PREV_ALLOC(HDRP(curr_ptr));
+    size_t next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(curr_ptr))) || NEXT_BLKP(curr_ptr) == top_ptr;    // the top is merged below
 
+    // a free block's predecessor is never free (it would have been merged), so merged blocks keep PREV_ALLOC
     // get current block size to compound prev or next freed block
     size_t curr_size = GET_SIZE(HDRP(curr_ptr));
 
@@ -221,14 +1140,14 @@ static void *coalesce(void *curr_ptr) {
     if(prev_alloc && !next_alloc) {
         curr_size += GET_SIZE(HDRP(NEXT_BLKP(curr_ptr)));  
         remove_free_block(NEXT_BLKP(curr_ptr));
-        PUT(HDRP(curr_ptr), PACK(curr_size, 0));
+        PUT(HDRP(curr_ptr), PACK(curr_size, PREV_ALLOC));
         PUT(FTRP(curr_ptr), PACK(curr_size, 0));
     // case 3 : prev block is free & next block is allocated (i.e. coalesce prev block)
     } else if(!prev_alloc && next_alloc) {
         curr_size += GET_SIZE(HDRP(PREV_BLKP(curr_ptr)));
         curr_ptr = PREV_BLKP(curr_ptr); 
         remove_free_block(curr_ptr);
-        PUT(HDRP(curr_ptr), PACK(curr_size, 0));
+        PUT(HDRP(curr_ptr), PACK(curr_size, PREV_ALLOC));
         PUT(FTRP(curr_ptr), PACK(curr_size, 0));
     // case 4 : previous & next block are both free (i.e. coalesce next & prev block)
     } else if (!prev_alloc && !next_alloc) { 
@@ -236,21 +1155,28 @@ static void *coalesce(void *curr_ptr) {
         remove_free_block(PREV_BLKP(curr_ptr));
         remove_free_block(NEXT_BLKP(curr_ptr));
         curr_ptr = PREV_BLKP(curr_ptr);
-        PUT(HDRP(curr_ptr), PACK(curr_size, 0));
+        PUT(HDRP(curr_ptr), PACK(curr_size, PREV_ALLOC));
+        PUT(FTRP(curr_ptr), PACK(curr_size, 0));
+    }
+
+    // a block that reaches the top chunk (or the epilogue) becomes the new top instead of entering a list
+    if(NEXT_BLKP(curr_ptr) == top_ptr || GET_SIZE(HDRP(NEXT_BLKP(curr_ptr))) == 0) {
+        if(NEXT_BLKP(curr_ptr) == top_ptr)
+            curr_size += GET_SIZE(HDRP(top_ptr));
+        PUT(HDRP(curr_ptr), PACK(curr_size, PREV_ALLOC));
         PUT(FTRP(curr_ptr), PACK(curr_size, 0));
+        top_ptr = curr_ptr;
+        return curr_ptr;
     }
 
-    // insert the coalesced block at the front of the free list
-    NEXT_FREE(curr_ptr) = free_list_ptr;
-    PREV_FREE(free_list_ptr) = curr_ptr;
-    PREV_FREE(curr_ptr) = NULL;
-    free_list_ptr = curr_ptr;
+    // insert the coalesced block at the front of its size class
+    insert_free_block(curr_ptr);
 
     return curr_ptr;
 }
 
 // skeletal code from CS:APP - diagram 9.45
-// [MOD] increase the size heap if free list cannot handle new payload
+// [MOD] increase the size heap if free list cannot handle new payload, the new space grows the top chunk
 static void *extend_heap(size_t curr_size) {
       char *curr_ptr;
       size_t alloc_size;
@@ -260,64 +1186,1084 @@ static void *extend_heap(size_t curr_size) {
       if (alloc_size < DEFAULTBLOCKSIZE)
             alloc_size = DEFAULTBLOCKSIZE;
 
-      // attempt to grow the heap by the adjusted size 
-      if ((curr_ptr = mem_sbrk(alloc_size)) == (void *)-1)
+      // [MOD] a request smaller than the chunk gets the whole chunk, bigger ones are grown exactly
+      // (the chunk doubles per extension but stays below growth_percent of the heap, which bounds the unused top)
+      if (alloc_size < growth_chunk)
+            alloc_size = growth_chunk;
+      growth_chunk = MAX(growth_min_chunk, MIN(2 * growth_chunk, ALIGN(mem_heapsize() / 100 * growth_percent)));
+
+      // attempt to grow the heap by the adjusted size ([MOD] mem_sbrk takes an int, larger sizes would wrap)
+      if (alloc_size > INT_MAX || (curr_ptr = mem_sbrk(alloc_size)) == (void *)-1)
             return NULL;
 
-      // set the hdr and ftr of the newly created free block
-      PUT(HDRP(curr_ptr), PACK(alloc_size, 0));
-      PUT(FTRP(curr_ptr), PACK(alloc_size, 0));
       // make the epilogue (tail) at the end
-      PUT(HDRP(NEXT_BLKP(curr_ptr)), PACK(0, 1));
+      PUT(curr_ptr + alloc_size - SIZE4, PACK(0, 1));
+
+      // [MOD] memlib does not clear what it hands out again: only bytes above dirty_hi are still zero
+      // (the old top footer and epilogue end up inside the top, they are cleared so a zero run across them continues;
+      // after trim_top they sit below dirty_hi, where the new space is stale and zero_ptr moves past it)
+      if(top_ptr) {
+            PUT(curr_ptr - SIZE8, 0);
+            PUT(curr_ptr - SIZE4, 0);
+      }
+      if(top_ptr && curr_ptr >= dirty_hi)
+            zero_ptr = MIN(zero_ptr, curr_ptr - SIZE8);
+      else
+            zero_ptr = MAX(curr_ptr, dirty_hi);
+      dirty_hi = MAX(dirty_hi, curr_ptr + alloc_size);
 
-      return coalesce(curr_ptr); 
+      // the new space either lengthens the top chunk or, right behind an allocated block, becomes it
+      if(top_ptr) {
+            alloc_size += GET_SIZE(HDRP(top_ptr));
+            curr_ptr = top_ptr;
+      }
+      // the old top / old epilogue header knows whether the block before is allocated
+      PUT(HDRP(curr_ptr), PACK(alloc_size, GET_PREV_ALLOC(HDRP(curr_ptr))));
+      PUT(FTRP(curr_ptr), PACK(alloc_size, 0));
+      top_ptr = curr_ptr;
+
+      return top_ptr;
 }
 
-// [MOD] find the first fit in the free list
-static void *find_first_fit(size_t size) {
-  void *ff_ptr;
+// [MOD] cut an allocated block of block_size down to alloc_size, a tail big enough for a block is freed
+static void shrink_block(void *curr_ptr, size_t block_size, size_t alloc_size) {
+    size_t prev_alloc = GET_PREV_ALLOC(HDRP(curr_ptr));
+    void *next_ptr;
 
-    for(ff_ptr = free_list_ptr; GET_ALLOC(HDRP(ff_ptr)) == 0; ff_ptr = NEXT_FREE(ff_ptr)) {
-        if(size <= GET_SIZE(HDRP(ff_ptr)))
-            return ff_ptr;
+    // a remainder smaller than the minimum block cannot hold the free list links, keep it
+    if(block_size - alloc_size < DEFAULTBLOCKSIZE) {
+        PUT(HDRP(curr_ptr), PACK(block_size, prev_alloc|1));
+        SET_PREV_ALLOC(HDRP(NEXT_BLKP(curr_ptr)));
+        return;
     }
 
-    return NULL;
+    PUT(HDRP(curr_ptr), PACK(alloc_size, prev_alloc|1));
+    next_ptr = NEXT_BLKP(curr_ptr);
+    PUT(HDRP(next_ptr), PACK(block_size - alloc_size, PREV_ALLOC|1));
+    free_block(next_ptr);
 }
 
-// [MOD] places payload into the curr_ptr position
-static void place(void *curr_ptr, size_t alloc_size) {
-    // Gets the total size of the free block 
-    size_t free_size = GET_SIZE(HDRP(curr_ptr));
+// [MOD] mark a block grown and remember how much of it the request needed, returns the block
+static void *headroom_track(void *curr_ptr, size_t need_size) {
+    int i = headroom_next;
 
+    if(curr_ptr == NULL)
+        return NULL;
+
+    // take an empty slot, if there is none shrink the block in the next slot back to its need
+    while(headroom_ptr[i] != NULL && (i = (i + 1) % HEADROOM_SLOTS) != headroom_next)
+        ;
+    if(headroom_ptr[i] != NULL) {
+        headroom_release(i);
+        headroom_next = (i + 1) % HEADROOM_SLOTS;
+    }
+
+    headroom_ptr[i] = curr_ptr;
+    headroom_need[i] = need_size;
+    headroom_bytes += GET_SIZE(HDRP(curr_ptr)) - need_size;
+    headroom_peak = MAX(headroom_peak, headroom_bytes);
+    PUT(HDRP(curr_ptr), GET(HDRP(curr_ptr)) | GROWN);
+
+    return curr_ptr;
+}
+
+// [MOD] the block is freed or about to change, drop it from the headroom slots
+static void headroom_forget(void *curr_ptr) {
+    int i;
+
+    for(i = 0; i < HEADROOM_SLOTS; i++) {
+        if(headroom_ptr[i] == curr_ptr) {
+            headroom_bytes -= GET_SIZE(HDRP(curr_ptr)) - headroom_need[i];
+            headroom_ptr[i] = NULL;
+            break;
+        }
+    }
+    PUT(HDRP(curr_ptr), GET(HDRP(curr_ptr)) & ~GROWN);
+}
+
+// [MOD] shrink the block in a headroom slot back to what its last request needed and empty the slot
+static void headroom_release(int slot) {
+    void *curr_ptr = headroom_ptr[slot];
+    size_t need_size = headroom_need[slot];
+    size_t curr_size = GET_SIZE(HDRP(curr_ptr));
+
+    headroom_forget(curr_ptr);
+    if(curr_size - need_size >= DEFAULTBLOCKSIZE) {
+        headroom_reclaimed += curr_size - need_size;
+        shrink_block(curr_ptr, curr_size, need_size);
+    }
+}
+
+// [MOD] memory is getting tight, release every headroom slot, returns 0 if no bytes came back
+static int headroom_reclaim(void) {
+    size_t before = headroom_reclaimed;
+    int i;
+
+    if(headroom_bytes == 0)
+        return 0;
+    for(i = 0; i < HEADROOM_SLOTS; i++)
+        if(headroom_ptr[i] != NULL)
+            headroom_release(i);
+
+    return headroom_reclaimed != before;
+}
+
+// [MOD] give the top chunk back to memlib down to TRIM_PAD bytes, so a block growing at the top does not thrash
+static void trim_top(void) {
+    size_t top_size = GET_SIZE(HDRP(top_ptr));
+
+    if(mem_sbrk(-(int)(top_size - TRIM_PAD)) == (void *)-1)
+        return;
+    growth_chunk = growth_min_chunk;    // the heap stopped growing
+
+    // the block before the top is always allocated
+    PUT(HDRP(top_ptr), PACK(TRIM_PAD, PREV_ALLOC));
+    PUT(FTRP(top_ptr), PACK(TRIM_PAD, 0));
+    PUT(HDRP(NEXT_BLKP(top_ptr)), PACK(0, 1));
+}
+
+// [MOD] cut an allocated block of alloc_size from the front of the top chunk, extending the heap if needed
+static void *take_from_top(size_t alloc_size) {
+    size_t top_size = top_ptr ? GET_SIZE(HDRP(top_ptr)) : 0;
+    size_t prev_alloc;
+    char *curr_ptr;
+
+    if(top_size < alloc_size) {
+        if(extend_heap((alloc_size - top_size) / SIZE4) == NULL)
+            return NULL;
+        top_size = GET_SIZE(HDRP(top_ptr));
+    }
+
+    curr_ptr = top_ptr;
+    prev_alloc = GET_PREV_ALLOC(HDRP(curr_ptr));
+
+    if((top_size - alloc_size) >= DEFAULTBLOCKSIZE) {
+        PUT(HDRP(curr_ptr), PACK(alloc_size, prev_alloc|1));
+        top_ptr = NEXT_BLKP(curr_ptr);
+        PUT(HDRP(top_ptr), PACK(top_size - alloc_size, PREV_ALLOC));
+        PUT(FTRP(top_ptr), PACK(top_size - alloc_size, 0));
+    } else {
+        PUT(HDRP(curr_ptr), PACK(top_size, prev_alloc|1));
+        PUT(FTRP(curr_ptr), 0);     // the old footer is in the payload now
+        SET_PREV_ALLOC(HDRP(NEXT_BLKP(curr_ptr)));
+        top_ptr = NULL;
+    }
+    carve_zero = zero_ptr;
+    zero_ptr = MAX(zero_ptr, (char *)NEXT_BLKP(curr_ptr));
+
+    return curr_ptr;
+}
+
+// [MOD] give a huge request a mapping of its own, see "mapped block visualized"
+static void *map_block(size_t size) {
+    size_t map_size = ALIGN(size + MAPPED_HDR);
+    char *map_ptr;
+
+    map_size = (map_size + mem_pagesize() - 1) & ~(mem_pagesize() - 1);
+    if(map_size < size || (map_ptr = mem_map(map_size)) == (void *)-1)
+        return NULL;
+
+    map_ptr += MAPPED_HDR;
+    MAPPED_SIZE(map_ptr) = map_size;
+    PUT(HDRP(map_ptr), PACK(0, 1));
+
+    return map_ptr;
+}
+
+#ifdef MM_TLSF
+// [MOD] TLSF good-fit: round the request up to the next list boundary, then every block found fits
+static void *find_fit(size_t size) {
+    int class_idx, fl, sl;
+    unsigned int map;
+    size_t round_size = size;
+
+    if(size >= (1 << FL_SHIFT))
+        round_size += (1 << (FLS(size) - SL_LOG2)) - 1;
+
+    class_idx = get_class(round_size);
+    fl = class_idx / SL_COUNT;
+    sl = class_idx % SL_COUNT;
+
+    // a non-empty list in the same first level, otherwise the smallest non-empty larger first level
+    map = sl_bitmap[fl] & (~0U << sl);
+    if(!map) {
+        map = fl_bitmap & (~0U << (fl + 1));
+        if(!map)
+            return NULL;
+        fl = FFS(map);
+        map = sl_bitmap[fl];
+    }
+    sl = FFS(map);
+
+    return list_fit(fl * SL_COUNT + sl, size);
+}
+#else
+// [MOD] find a fit starting from the size class of the request, large requests go to the tree
+static void *find_fit(size_t size) {
+    void *fit_ptr;
+    int class_idx = get_class(size);
+
+    if(size >= TREE_MIN)
+        return tree_best_fit(size);
+
+    // the first class may hold blocks smaller than the request, so it is searched by the policy
+    if((fit_ptr = list_fit(class_idx, size)))
+        return fit_ptr;
+
+    // every block of a larger class is big enough, so the first non-empty list wins
+    for(class_idx++; class_idx < NUM_CLASSES; class_idx++) {
+        if(seg_list[class_idx])
+            return policy == MM_POLICY_FIRST_FIT ? seg_list[class_idx] : list_fit(class_idx, size);
+    }
+
+    // otherwise the smallest tree block
+    return tree_best_fit(size);
+}
+#endif
+
+// [MOD] search one segregated list for a block of at least size bytes the way the policy says
+static void *list_fit(int class_idx, size_t size) {
+    char *fit_ptr, *best_ptr = NULL;
+    char *start_ptr;
+    int fits = 0;
+
+    switch(policy) {
+    // walk from the rover to the end, then from the head up to where the walk started (no rover: the head, one pass)
+    case MM_POLICY_NEXT_FIT:
+        start_ptr = rover[class_idx] ? rover[class_idx] : seg_list[class_idx];
+        for(fit_ptr = start_ptr; fit_ptr != NULL; fit_ptr = NEXT_FREE(fit_ptr))
+            if(size <= GET_SIZE(HDRP(fit_ptr)))
+                return rover[class_idx] = fit_ptr;
+        for(fit_ptr = seg_list[class_idx]; fit_ptr != start_ptr; fit_ptr = NEXT_FREE(fit_ptr))
+            if(size <= GET_SIZE(HDRP(fit_ptr)))
+                return rover[class_idx] = fit_ptr;
+        return NULL;
+
+    // the smallest of the first BEST_OF_N blocks that fit, an exact fit ends the search
+    case MM_POLICY_BEST_OF_N:
+        for(fit_ptr = seg_list[class_idx]; fit_ptr != NULL && fits < BEST_OF_N; fit_ptr = NEXT_FREE(fit_ptr)) {
+            if(size <= GET_SIZE(HDRP(fit_ptr))) {
+                if(best_ptr == NULL || GET_SIZE(HDRP(fit_ptr)) < GET_SIZE(HDRP(best_ptr)))
+                    best_ptr = fit_ptr;
+                if(GET_SIZE(HDRP(fit_ptr)) == size)
+                    break;
+                fits++;
+            }
+        }
+        return best_ptr;
+
+    // first fit, in address order the lowest block that fits
+    default:
+        for(fit_ptr = seg_list[class_idx]; fit_ptr != NULL; fit_ptr = NEXT_FREE(fit_ptr))
+            if(size <= GET_SIZE(HDRP(fit_ptr)))
+                return fit_ptr;
+        return NULL;
+    }
+}
+
+// [MOD] places payload into the curr_ptr position
+static void place(void *curr_ptr, size_t alloc_size) {
+    // Gets the total size of the free block 
+    size_t free_size = GET_SIZE(HDRP(curr_ptr));
+
+    // unlink while the header still holds the size that picked the class
+    remove_free_block(curr_ptr);
+
+    size_t prev_alloc = GET_PREV_ALLOC(HDRP(curr_ptr));
+
+    // the allocated part keeps the free block's PREV_ALLOC bit, the remainder follows an allocated block
     if((free_size - alloc_size) >= DEFAULTBLOCKSIZE) {
-        PUT(HDRP(curr_ptr), PACK(alloc_size,1));
-        PUT(FTRP(curr_ptr), PACK(alloc_size,1));
+        PUT(HDRP(curr_ptr), PACK(alloc_size,prev_alloc|1));
 
-        remove_free_block(curr_ptr);
         curr_ptr = NEXT_BLKP(curr_ptr);
 
-        PUT(HDRP(curr_ptr), PACK(free_size - alloc_size, 0));
+        PUT(HDRP(curr_ptr), PACK(free_size - alloc_size, PREV_ALLOC));
         PUT(FTRP(curr_ptr), PACK(free_size - alloc_size, 0));
 
         coalesce(curr_ptr);
     } else {
-        PUT(HDRP(curr_ptr), PACK(free_size, 1));
-        PUT(FTRP(curr_ptr), PACK(free_size, 1));
+        PUT(HDRP(curr_ptr), PACK(free_size, prev_alloc|1));
+        SET_PREV_ALLOC(HDRP(NEXT_BLKP(curr_ptr)));
+    }
+}
 
-        remove_free_block(curr_ptr);
+#ifdef MM_TLSF
+// [MOD] map a block size to its (first level, second level) list, flattened into seg_list
+static int get_class(size_t size) {
+    int fl, sl;
+
+    if(size < (1 << FL_SHIFT))
+        return size >> 3;
+
+    fl = FLS(size);
+    sl = (size >> (fl - SL_LOG2)) - SL_COUNT;
+    fl -= FL_SHIFT - 1;
+
+    return fl * SL_COUNT + sl;
+}
+#else
+// [MOD] map a block size to its segregated list (power-of-two classes from 16 bytes)
+static int get_class(size_t size) {
+    int class_idx = 0;
+
+    size >>= 5;
+    while(size && class_idx < NUM_CLASSES - 1) {
+        size >>= 1;
+        class_idx++;
+    }
+
+    return class_idx;
+}
+#endif
+
+// [MOD] Doubly Linked List LIFO insertion into the list of the block's size class
+static void insert_free_block(void *curr_ptr) {
+#ifndef MM_TLSF
+    if(GET_SIZE(HDRP(curr_ptr)) >= TREE_MIN) {
+        tree_insert(curr_ptr);
+        return;
+    }
+#endif
+    int class_idx = get_class(GET_SIZE(HDRP(curr_ptr)));
+    char *head_ptr = seg_list[class_idx];
+    char *prev_ptr = NULL;
+
+    // address ordered -> hang the block after the last listed block below it, otherwise at the head (LIFO)
+    if(policy == MM_POLICY_ADDR_ORDER) {
+        while(head_ptr != NULL && head_ptr < (char *)curr_ptr) {
+            prev_ptr = head_ptr;
+            head_ptr = NEXT_FREE(head_ptr);
+        }
     }
+
+    SET_NEXT_FREE(curr_ptr, head_ptr);
+    SET_PREV_FREE(curr_ptr, prev_ptr);
+    if(head_ptr)
+        SET_PREV_FREE(head_ptr, curr_ptr);
+    if(prev_ptr)
+        SET_NEXT_FREE(prev_ptr, curr_ptr);
+    else
+        seg_list[class_idx] = curr_ptr;
+#ifdef MM_TLSF
+    fl_bitmap |= 1U << (class_idx / SL_COUNT);
+    sl_bitmap[class_idx / SL_COUNT] |= 1U << (class_idx % SL_COUNT);
+#endif
 }
 
 // [MOD] Doubly Linked List node removal function
 static void remove_free_block(void *curr_ptr) {
+#ifndef MM_TLSF
+    if(curr_ptr && GET_SIZE(HDRP(curr_ptr)) >= TREE_MIN) {
+        tree_remove(curr_ptr);
+        return;
+    }
+#endif
     if(curr_ptr) {
+        int class_idx = get_class(GET_SIZE(HDRP(curr_ptr)));
+
+        // the rover must not point at a block that leaves its list (taken by place, merged by coalesce or realloc),
+        // it moves on to the next block, past the last one the next search starts at the head again
+        if(rover[class_idx] == curr_ptr)
+            rover[class_idx] = NEXT_FREE(curr_ptr);
+
         if(PREV_FREE(curr_ptr))
-            NEXT_FREE(PREV_FREE(curr_ptr)) = NEXT_FREE(curr_ptr);
-        else
-            free_list_ptr = NEXT_FREE(curr_ptr);
+            SET_NEXT_FREE(PREV_FREE(curr_ptr), NEXT_FREE(curr_ptr));
+        else {
+            seg_list[class_idx] = NEXT_FREE(curr_ptr);
+#ifdef MM_TLSF
+            // last block of the list gone -> clear its bit, and the first level bit if it was the last list
+            if(seg_list[class_idx] == NULL) {
+                sl_bitmap[class_idx / SL_COUNT] &= ~(1U << (class_idx % SL_COUNT));
+                if(sl_bitmap[class_idx / SL_COUNT] == 0)
+                    fl_bitmap &= ~(1U << (class_idx / SL_COUNT));
+            }
+#endif
+        }
 
         if(NEXT_FREE(curr_ptr) != NULL)
-            PREV_FREE(NEXT_FREE(curr_ptr)) = PREV_FREE(curr_ptr);
+            SET_PREV_FREE(NEXT_FREE(curr_ptr), PREV_FREE(curr_ptr));
+    }
+}
+
+#ifndef MM_TLSF
+/***** [MOD] RED-BLACK TREE OF LARGE FREE BLOCKS *****/
+
+// [MOD] hang new_node where old_node was under old_node's parent
+static void tree_replace(void *old_node, void *new_node) {
+    void *parent = TREE_PARENT(old_node);
+
+    if(parent == NULL)
+        tree_root = new_node;
+    else if(old_node == TREE_LEFT(parent))
+        SET_LEFT(parent, new_node);
+    else
+        SET_RIGHT(parent, new_node);
+
+    if(new_node)
+        SET_PARENT(new_node, parent);
+}
+
+// [MOD] left rotation around node, its right child takes its place
+static void tree_rotate_left(void *node) {
+    void *child = TREE_RIGHT(node);
+
+    SET_RIGHT(node, TREE_LEFT(child));
+    if(TREE_LEFT(child))
+        SET_PARENT(TREE_LEFT(child), node);
+    tree_replace(node, child);
+    SET_LEFT(child, node);
+    SET_PARENT(node, child);
+}
+
+// [MOD] right rotation around node, its left child takes its place
+static void tree_rotate_right(void *node) {
+    void *child = TREE_LEFT(node);
+
+    SET_LEFT(node, TREE_RIGHT(child));
+    if(TREE_RIGHT(child))
+        SET_PARENT(TREE_RIGHT(child), node);
+    tree_replace(node, child);
+    SET_RIGHT(child, node);
+    SET_PARENT(node, child);
+}
+
+// [MOD] ordinary BST insertion followed by the red-black recoloring / rotations
+static void tree_insert(void *node) {
+    void *parent = NULL;
+    void *curr_ptr = tree_root;
+    void *grand, *uncle;
+
+    while(curr_ptr) {
+        parent = curr_ptr;
+        curr_ptr = TREE_LESS(node, curr_ptr) ? TREE_LEFT(curr_ptr) : TREE_RIGHT(curr_ptr);
+    }
+
+    SET_LEFT(node, NULL);
+    SET_RIGHT(node, NULL);
+    SET_PARENT(node, parent);
+    SET_COLOR(node, RED);
+    if(parent == NULL)
+        tree_root = node;
+    else if(TREE_LESS(node, parent))
+        SET_LEFT(parent, node);
+    else
+        SET_RIGHT(parent, node);
+
+    // a red node may not have a red parent
+    while((parent = TREE_PARENT(node)) && TREE_COLOR(parent) == RED) {
+        grand = TREE_PARENT(parent);
+
+        if(parent == TREE_LEFT(grand)) {
+            uncle = TREE_RIGHT(grand);
+            if(TREE_COLOR(uncle) == RED) {
+                SET_COLOR(parent, BLACK);
+                SET_COLOR(uncle, BLACK);
+                SET_COLOR(grand, RED);
+                node = grand;
+                continue;
+            }
+            if(node == TREE_RIGHT(parent)) {
+                node = parent;
+                tree_rotate_left(node);
+                parent = TREE_PARENT(node);
+            }
+            SET_COLOR(parent, BLACK);
+            SET_COLOR(grand, RED);
+            tree_rotate_right(grand);
+        } else {
+            uncle = TREE_LEFT(grand);
+            if(TREE_COLOR(uncle) == RED) {
+                SET_COLOR(parent, BLACK);
+                SET_COLOR(uncle, BLACK);
+                SET_COLOR(grand, RED);
+                node = grand;
+                continue;
+            }
+            if(node == TREE_LEFT(parent)) {
+                node = parent;
+                tree_rotate_right(node);
+                parent = TREE_PARENT(node);
+            }
+            SET_COLOR(parent, BLACK);
+            SET_COLOR(grand, RED);
+            tree_rotate_left(grand);
+        }
+    }
+
+    SET_COLOR(tree_root, BLACK);
+}
+
+// [MOD] CLRS deletion, child may be NULL so its parent is tracked separately
+static void tree_remove(void *node) {
+    void *moved = node;
+    void *child, *parent, *sibling;
+    int removed_color = TREE_COLOR(node);
+
+    if(TREE_LEFT(node) == NULL) {
+        child = TREE_RIGHT(node);
+        parent = TREE_PARENT(node);
+        tree_replace(node, child);
+    } else if(TREE_RIGHT(node) == NULL) {
+        child = TREE_LEFT(node);
+        parent = TREE_PARENT(node);
+        tree_replace(node, child);
+    } else {
+        // two children -> the in-order successor takes the node's place
+        for(moved = TREE_RIGHT(node); TREE_LEFT(moved); moved = TREE_LEFT(moved))
+            ;
+        removed_color = TREE_COLOR(moved);
+        child = TREE_RIGHT(moved);
+
+        if(TREE_PARENT(moved) == node) {
+            parent = moved;
+        } else {
+            parent = TREE_PARENT(moved);
+            tree_replace(moved, child);
+            SET_RIGHT(moved, TREE_RIGHT(node));
+            SET_PARENT(TREE_RIGHT(moved), moved);
+        }
+        tree_replace(node, moved);
+        SET_LEFT(moved, TREE_LEFT(node));
+        SET_PARENT(TREE_LEFT(moved), moved);
+        SET_COLOR(moved, TREE_COLOR(node));
+    }
+
+    if(removed_color == RED)
+        return;
+
+    // a black node went missing on child's path, push the extra black up or fix it by rotation
+    while(child != tree_root && TREE_COLOR(child) == BLACK) {
+        if(child == TREE_LEFT(parent)) {
+            sibling = TREE_RIGHT(parent);
+            if(TREE_COLOR(sibling) == RED) {
+                SET_COLOR(sibling, BLACK);
+                SET_COLOR(parent, RED);
+                tree_rotate_left(parent);
+                sibling = TREE_RIGHT(parent);
+            }
+            if(TREE_COLOR(TREE_LEFT(sibling)) == BLACK && TREE_COLOR(TREE_RIGHT(sibling)) == BLACK) {
+                SET_COLOR(sibling, RED);
+                child = parent;
+                parent = TREE_PARENT(child);
+                continue;
+            }
+            if(TREE_COLOR(TREE_RIGHT(sibling)) == BLACK) {
+                SET_COLOR(TREE_LEFT(sibling), BLACK);
+                SET_COLOR(sibling, RED);
+                tree_rotate_right(sibling);
+                sibling = TREE_RIGHT(parent);
+            }
+            SET_COLOR(sibling, TREE_COLOR(parent));
+            SET_COLOR(parent, BLACK);
+            SET_COLOR(TREE_RIGHT(sibling), BLACK);
+            tree_rotate_left(parent);
+        } else {
+            sibling = TREE_LEFT(parent);
+            if(TREE_COLOR(sibling) == RED) {
+                SET_COLOR(sibling, BLACK);
+                SET_COLOR(parent, RED);
+                tree_rotate_right(parent);
+                sibling = TREE_LEFT(parent);
+            }
+            if(TREE_COLOR(TREE_LEFT(sibling)) == BLACK && TREE_COLOR(TREE_RIGHT(sibling)) == BLACK) {
+                SET_COLOR(sibling, RED);
+                child = parent;
+                parent = TREE_PARENT(child);
+                continue;
+            }
+            if(TREE_COLOR(TREE_LEFT(sibling)) == BLACK) {
+                SET_COLOR(TREE_RIGHT(sibling), BLACK);
+                SET_COLOR(sibling, RED);
+                tree_rotate_left(sibling);
+                sibling = TREE_LEFT(parent);
+            }
+            SET_COLOR(sibling, TREE_COLOR(parent));
+            SET_COLOR(parent, BLACK);
+            SET_COLOR(TREE_LEFT(sibling), BLACK);
+            tree_rotate_right(parent);
+        }
+        child = tree_root;
+    }
+
+    if(child)
+        SET_COLOR(child, BLACK);
+}
+
+// [MOD] smallest (size, address) node that still holds size bytes
+static void *tree_best_fit(size_t size) {
+    void *curr_ptr = tree_root;
+    void *best_ptr = NULL;
+
+    while(curr_ptr) {
+        if(GET_SIZE(HDRP(curr_ptr)) >= size) {
+            best_ptr = curr_ptr;
+            curr_ptr = TREE_LEFT(curr_ptr);
+        } else {
+            curr_ptr = TREE_RIGHT(curr_ptr);
+        }
+    }
+
+    return best_ptr;
+}
+#endif
+
+/***** [MOD] SLAB TIER FOR SMALL OBJECTS *****/
+
+// [MOD] descriptor of the slab on the heap page of curr_ptr, NULL if that page is not a slab
+static slab_t *page_lookup(void *curr_ptr) {
+    size_t page = PAGE_IDX(curr_ptr);
+    slab_t **leaf;
+
+    if(page >= HEAP_PAGES || (leaf = page_map[page >> PAGEMAP_LEAF_BITS]) == NULL)
+        return NULL;
+    return leaf[page & (PAGEMAP_LEAF - 1)];
+}
+
+// [MOD] point the page map entry of a heap page at a descriptor (NULL clears it)
+static void page_map_set(void *page_ptr, slab_t *slab) {
+    size_t page = PAGE_IDX(page_ptr);
+    slab_t **leaf = page_map[page >> PAGEMAP_LEAF_BITS];
+
+    if(leaf == NULL) {
+        leaf = page_leaf[page >> PAGEMAP_LEAF_BITS];
+        memset(leaf, 0, sizeof(page_leaf[0]));
+        page_map[page >> PAGEMAP_LEAF_BITS] = leaf;
+    }
+    leaf[page & (PAGEMAP_LEAF - 1)] = slab;
+}
+
+// [MOD] unlink a descriptor from the unused ones
+static void desc_unlink(slab_t *slab) {
+    if(slab->prev)
+        slab->prev->next = slab->next;
+    else
+        desc_free = slab->next;
+    if(slab->next)
+        slab->next->prev = slab->prev;
+}
+
+// [MOD] take an unused descriptor, a new descriptor block is allocated and carved when there is none
+static slab_t *desc_alloc(void) {
+    desc_block_t *block;
+    slab_t *slab;
+    int i;
+
+    // descriptor blocks are larger than SLAB_MAX, so this never comes back into the slab tier
+    if(desc_free == NULL) {
+        if((block = mm_malloc(sizeof(desc_block_t))) == NULL)
+            return NULL;
+        block->used = 0;
+        for(i = 0; i < DESC_CHUNK; i++) {
+            block->desc[i].block = block;
+            block->desc[i].prev = NULL;
+            block->desc[i].next = desc_free;
+            if(desc_free)
+                desc_free->prev = &block->desc[i];
+            desc_free = &block->desc[i];
+        }
+    }
+    slab = desc_free;
+    desc_unlink(slab);
+    slab->block->used++;
+
+    return slab;
+}
+
+// [MOD] keep a descriptor that is no longer used for the next slab or region, a block of unused ones goes back to the heap
+static void desc_release(slab_t *slab) {
+    desc_block_t *block = slab->block;
+    int i;
+
+    slab->prev = NULL;
+    slab->next = desc_free;
+    if(desc_free)
+        desc_free->prev = slab;
+    desc_free = slab;
+
+    // a block kept for later would sit in the heap for good and could pin the top chunk
+    if(--block->used == 0) {
+        for(i = 0; i < DESC_CHUNK; i++)
+            desc_unlink(&block->desc[i]);
+        free_block(block);
+    }
+}
+
+// [MOD] index of the first free slot, the slab is known to have one
+static int slab_find_slot(slab_t *slab) {
+    int i;
+#ifdef __SSE2__
+    // compare four bitmap words with zero at once, the mask tells which word has a free slot
+    __m128i zero = _mm_setzero_si128();
+    int zero_mask;
+
+    for(i = 0; i < SLAB_MAP_WORDS; i += 4) {
+        zero_mask = _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_loadu_si128((__m128i *)&slab->free_map[i]), zero));
+        if(zero_mask != 0xFFFF) {
+            i += __builtin_ctz(~zero_mask) / 4;
+            return i * 32 + __builtin_ctz(slab->free_map[i]);
+        }
+    }
+#else
+    for(i = 0; i < SLAB_MAP_WORDS; i++) {
+        if(slab->free_map[i])
+            return i * 32 + __builtin_ctz(slab->free_map[i]);
+    }
+#endif
+    return -1;
+}
+
+// [MOD] unlink a slab from the partial list of its class (class -1: a span from span_list)
+static void slab_unlink(slab_t *slab, int class_idx) {
+    if(slab->prev)
+        slab->prev->next = slab->next;
+    else if(class_idx < 0)
+        span_list = slab->next;
+    else
+        slab_partial[class_idx] = slab->next;
+    if(slab->next)
+        slab->next->prev = slab->prev;
+}
+
+// [MOD] push a slab onto the partial list of its class (class -1: a span onto span_list)
+static void slab_link(slab_t *slab, int class_idx) {
+    slab_t **head = (class_idx < 0) ? &span_list : &slab_partial[class_idx];
+
+    slab->prev = NULL;
+    slab->next = *head;
+    if(slab->next)
+        slab->next->prev = slab;
+    *head = slab;
+}
+
+// [MOD] carve a fresh span of slab pages out of the heap, sized after the pages the slabs hold
+static slab_t *span_new(void) {
+    unsigned int span_pages = MIN(MAX(span_used / SPAN_DIV, 1), span_max);
+    slab_t *span;
+
+    if((span = desc_alloc()) == NULL)
+        return NULL;
+    if((span->slots = alloc_aligned(SLAB_SIZE, ALIGN(span_pages * SLAB_SIZE + SIZE4))) == NULL) {
+        desc_release(span);
+        return NULL;
+    }
+
+    span->num_slots = span_pages;
+    span->used = 0;
+    span->free_map[0] = (span_pages == 32) ? ~0U : (1U << span_pages) - 1;
+    slab_link(span, -1);
+
+    return span;
+}
+
+// [MOD] take a free page from the first span that has one, a new span is carved when there is none
+static char *span_take_page(slab_t *slab) {
+    slab_t *span = span_list;
+    int page;
+
+    if(span == NULL && (span = span_new()) == NULL)
+        return NULL;
+
+    page = __builtin_ctz(span->free_map[0]);
+    span->free_map[0] &= ~(1U << page);
+    if(++span->used == span->num_slots)
+        slab_unlink(span, -1);
+    span_used++;
+
+    slab->span = span;
+    return span->slots + page * SLAB_SIZE;
+}
+
+// [MOD] the span borders a top chunk that can carve the next span by itself, keeping it empty only pins the heap
+static int span_at_top(slab_t *span) {
+    return top_ptr && (char *)NEXT_BLKP(span->slots) == top_ptr && GET_SIZE(HDRP(top_ptr)) >= TRIM_PAD;
+}
+
+// [MOD] give a slab page back to its span, an empty span goes back to the heap unless it is the only one with free pages
+// (and then too once it borders the top chunk)
+static void span_put_page(slab_t *span, char *page_ptr) {
+    int page = (page_ptr - span->slots) / SLAB_SIZE;
+
+    span->free_map[0] |= 1U << page;
+    span_used--;
+    if(span->used-- == span->num_slots)
+        slab_link(span, -1);
+
+    if(span->used == 0 && (span->prev || span->next || span_at_top(span))) {
+        slab_unlink(span, -1);
+        free_block(span->slots);
+        desc_release(span);
+    }
+}
+
+// [MOD] memory is getting tight, cut the free pages at the end of every span off, returns 0 if no page came back
+static int span_reclaim(void) {
+    slab_t *span, *next;
+    unsigned int used_map, keep;
+    int reclaimed = 0;
+
+    for(span = span_list; span != NULL; span = next) {
+        next = span->next;
+        used_map = ~span->free_map[0] & ((span->num_slots == 32) ? ~0U : (1U << span->num_slots) - 1);
+
+        // an empty span that is not alone goes back whole, one that is alone keeps a page
+        if(used_map == 0 && (span->prev || span->next)) {
+            slab_unlink(span, -1);
+            free_block(span->slots);
+            desc_release(span);
+            reclaimed = 1;
+            continue;
+        }
+        keep = used_map ? 32 - __builtin_clz(used_map) : 1;
+        if(keep == span->num_slots)
+            continue;
+
+        shrink_block(span->slots, GET_SIZE(HDRP(span->slots)), ALIGN(keep * SLAB_SIZE + SIZE4));
+        span->num_slots = keep;
+        span->free_map[0] &= (keep == 32) ? ~0U : (1U << keep) - 1;
+        if(span->used == span->num_slots)
+            slab_unlink(span, -1);
+        reclaimed = 1;
+    }
+
+    return reclaimed;
+}
+
+// [MOD] make a slab for a size class on a page of a span
+static slab_t *slab_new(int class_idx) {
+    slab_t *slab;
+    char *page_ptr;
+    size_t i;
+
+    if((slab = desc_alloc()) == NULL)
+        return NULL;
+    if((page_ptr = span_take_page(slab)) == NULL) {
+        desc_release(slab);
+        return NULL;
+    }
+    page_map_set(page_ptr, slab);
+
+    slab->slots = page_ptr;
+    slab->slot_size = (class_idx + 1) * SLAB_GRAIN;
+    slab->num_slots = SLAB_SIZE / slab->slot_size;
+    slab->used = 0;
+    memset(slab->free_map, 0, sizeof(slab->free_map));
+    for(i = 0; i < slab->num_slots; i++)
+        slab->free_map[i / 32] |= 1U << (i % 32);
+
+    slab_link(slab, class_idx);
+
+    return slab;
+}
+
+// [MOD] take a slot from the first partial slab of the size class
+static void *slab_malloc(size_t size) {
+    int class_idx = SLAB_CLASS(size);
+    slab_t *slab = slab_partial[class_idx];
+    int slot;
+
+    if(slab == NULL && (slab = slab_new(class_idx)) == NULL)
+        return NULL;
+
+    slot = slab_find_slot(slab);
+    slab->free_map[slot / 32] &= ~(1U << (slot % 32));
+    if(++slab->used == slab->num_slots)
+        slab_unlink(slab, class_idx);
+
+    return slab->slots + slot * slab->slot_size;
+}
+
+// [MOD] the slab's span borders the top chunk, its empty pages are not worth keeping there
+#define SLAB_AT_TOP(slab)       span_at_top((slab)->span)
+
+// [MOD] hand the page of an empty slab back to its span
+static void slab_release(slab_t *slab, int class_idx) {
+    slab_unlink(slab, class_idx);
+    page_map_set(slab->slots, NULL);
+    span_put_page(slab->span, slab->slots);
+    desc_release(slab);
+}
+
+// [MOD] return a slot, an empty slab goes back to the heap unless it is the last one of its class (and not at the top)
+static void slab_free(void *curr_ptr) {
+    slab_t *slab = SLAB_OF(curr_ptr);
+    int class_idx = SLAB_CLASS(slab->slot_size);
+    int slot = ((char *)curr_ptr - slab->slots) / slab->slot_size;
+
+    slab->free_map[slot / 32] |= 1U << (slot % 32);
+    if(slab->used-- == slab->num_slots)
+        slab_link(slab, class_idx);
+
+    if(slab->used == 0 && (slab->prev || slab->next || SLAB_AT_TOP(slab)))
+        slab_release(slab, class_idx);
+}
+
+// [MOD] the top chunk grew: give back the empty slabs and the empty span kept for reuse that border it now
+// (each span freed here merges into the top again, which releases the next one below it)
+static void slab_release_top(void) {
+    slab_t *slab;
+    int class_idx;
+
+    for(class_idx = 0; class_idx < NUM_SLAB_CLASSES; class_idx++) {
+        slab = slab_partial[class_idx];
+        if(slab && slab->used == 0 && SLAB_AT_TOP(slab))
+            slab_release(slab, class_idx);
+    }
+    if(span_list && span_list->used == 0 && span_at_top(span_list)) {
+        slab = span_list;
+        slab_unlink(slab, -1);
+        free_block(slab->slots);
+        desc_release(slab);
+    }
+    if(short_region && short_region->used == 0 && short_at_top(short_region))
+        short_release(short_region);
+}
+
+/***** [MOD] SHORT-LIVED REGIONS *****/
+
+// [MOD] point the page map entries of all pages of a region at its descriptor (NULL clears them)
+static void short_map(slab_t *region, slab_t *val) {
+    size_t offset;
+
+    for(offset = 0; offset < SHORT_REGION_SIZE; offset += SLAB_SIZE)
+        page_map_set(region->slots + offset, val);
+}
+
+// [MOD] carve a fresh page-aligned region for short-lived blocks out of the heap
+static slab_t *short_new(void) {
+    slab_t *region;
+
+    if((region = desc_alloc()) == NULL)
+        return NULL;
+    if((region->slots = alloc_aligned(SLAB_SIZE, ALIGN(SHORT_REGION_SIZE + SIZE4))) == NULL) {
+        desc_release(region);
+        return NULL;
+    }
+    short_map(region, region);
+
+    // the first header sits in front of an 8 byte aligned payload
+    region->slot_size = 0;
+    region->used = 0;
+    region->bump = SIZE4;
+
+    return region;
+}
+
+// [MOD] bump a block off the current region, a full region is retired and freed with its last block
+static void *short_malloc(size_t size) {
+    size_t block_size = ALIGN(size + SIZE4);
+    char *curr_ptr;
+
+    if(short_region && short_region->bump + block_size > SHORT_REGION_SIZE) {
+        if(short_region->used == 0)
+            short_region->bump = SIZE4;
+        else
+            short_region = NULL;
+    }
+    if(short_region == NULL && (short_region = short_new()) == NULL)
+        return NULL;
+
+    curr_ptr = short_region->slots + short_region->bump + SIZE4;
+    PUT(HDRP(curr_ptr), PACK(block_size, 1));
+    short_region->bump += block_size;
+    short_region->used++;
+
+    return curr_ptr;
+}
+
+// [MOD] an empty region right below the top chunk (or the epilogue) pins the heap, the next one is carved from the top again
+static int short_at_top(slab_t *region) {
+    char *next_ptr = NEXT_BLKP(region->slots);
+
+    return next_ptr == top_ptr || GET_SIZE(HDRP(next_ptr)) == 0;
+}
+
+// [MOD] give an empty region back to the heap
+static void short_release(slab_t *region) {
+    if(region == short_region)
+        short_region = NULL;
+    short_map(region, NULL);
+    free_block(region->slots);
+    desc_release(region);
+}
+
+// [MOD] the last free of a region frees all of it: the current region starts over unless it borders the top,
+// a retired one goes back to the heap
+static void short_free(slab_t *region, void *curr_ptr) {
+    if(--region->used > 0)
+        return;
+
+    if(region == short_region && !short_at_top(region)) {
+        region->bump = SIZE4;
+        return;
+    }
+    short_release(region);
+}
+
+/***** [MOD] COPY ENGINE *****/
+
+#ifdef MM_X86_COPY
+// [MOD] 16 byte unaligned loads, streaming stores aligned on the destination; the last vector overlaps the one before
+static void copy_stream_sse2(char *dst, const char *src, size_t size) {
+    size_t i;
+
+    _mm_storeu_si128((__m128i *)dst, _mm_loadu_si128((const __m128i *)src));
+    for(i = (16 - ((uintptr_t)dst & 15)) & 15; i + 16 <= size; i += 16)
+        _mm_stream_si128((__m128i *)(dst + i), _mm_loadu_si128((const __m128i *)(src + i)));
+    _mm_sfence();
+    _mm_storeu_si128((__m128i *)(dst + size - 16), _mm_loadu_si128((const __m128i *)(src + size - 16)));
+}
+
+// [MOD] same with 32 byte vectors, only called when the CPU has AVX2
+__attribute__((target("avx2")))
+static void copy_stream_avx2(char *dst, const char *src, size_t size) {
+    size_t i;
+
+    _mm256_storeu_si256((__m256i *)dst, _mm256_loadu_si256((const __m256i *)src));
+    for(i = (32 - ((uintptr_t)dst & 31)) & 31; i + 32 <= size; i += 32)
+        _mm256_stream_si256((__m256i *)(dst + i), _mm256_loadu_si256((const __m256i *)(src + i)));
+    _mm_sfence();
+    _mm256_storeu_si256((__m256i *)(dst + size - 32), _mm256_loadu_si256((const __m256i *)(src + size - 32)));
+    _mm256_zeroupper();
+}
+#endif
+
+// [MOD] pick the widest streaming loop the CPU runs and the size where it takes over from memcpy
+static void copy_init(void) {
+    long cache_size = -1;
+
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    cache_size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    // a copy bigger than the core's own cache would only evict the data around it
+    copy_stream_min = cache_size > 0 ? (size_t)cache_size : COPY_STREAM_DEFAULT;
+
+    copy_stream = NULL;
+#ifdef MM_X86_COPY
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        copy_stream = copy_stream_avx2;
+    else if(__builtin_cpu_supports("sse2"))
+        copy_stream = copy_stream_sse2;
+#endif
+}
+
+// [MOD] move a payload for mm_realloc, dispatched by size; overlapping moves (merging backwards) use memmove
+// (libc's memcpy already picks its vector width at load time and beats a plain vector loop below copy_stream_min)
+static void copy_block(void *dst, const void *src, size_t size) {
+    struct timespec start, end;
+
+    if(copy_timing)
+        clock_gettime(CLOCK_MONOTONIC, &start);
+    if((char *)dst < (char *)src + size && (char *)src < (char *)dst + size)
+        memmove(dst, src, size);
+    else if(size < copy_stream_min || copy_stream == NULL)
+        memcpy(dst, src, size);
+    else
+        copy_stream(dst, src, size);
+
+    realloc_copy_bytes += size;
+    if(copy_timing) {
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        realloc_copy_ns += (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
     }
 }
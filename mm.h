@@ -5,6 +5,137 @@ extern void *mm_malloc (size_t size);
 extern void mm_free (void *ptr);
 extern void *mm_realloc(void *ptr, size_t size);
 
+/* 
+ * Fastbins: freed blocks of the same small size are kept in per-size
+ * LIFO bins and only coalesced in batches. Bin i holds blocks of
+ * MM_FASTBIN_MIN + 8*i bytes (header included), the smallest blocks
+ * above the slab tier, which serves requests of up to 128 bytes.
+ */
+#define MM_NUM_FASTBINS 16
+#define MM_FASTBIN_MIN  136
+
+/*
+ * Realloc strategies of mm_realloc. Each call
+ * that keeps or moves a block is counted under the strategy used.
+ */
+#define MM_REALLOC_IN_PLACE  0 /* the block is already big enough */
+#define MM_REALLOC_TOP       1 /* grown into the top chunk / the heap end */
+#define MM_REALLOC_NEXT      2 /* merged with the free block after it */
+#define MM_REALLOC_PREV      3 /* merged with the free block before it, payload moved down */
+#define MM_REALLOC_COPY      4 /* new block, copy, free the old one */
+#define MM_REALLOC_REMAP     5 /* mapped block resized by remapping its pages */
+#define MM_NUM_REALLOC_PATHS 6
+
+typedef struct {
+    size_t fastbin_bytes[MM_NUM_FASTBINS]; /* bytes currently parked in each bin */
+    size_t fastbin_peak[MM_NUM_FASTBINS];  /* high water mark of fastbin_bytes */
+    size_t realloc_count[MM_NUM_REALLOC_PATHS]; /* mm_realloc calls per strategy */
+    size_t realloc_copy_bytes; /* payload bytes moved by mm_realloc */
+    double realloc_copy_ns;    /* nanoseconds spent moving them (mm_set_copy_timing) */
+    size_t headroom_bytes;     /* realloc headroom currently held by grown blocks */
+    size_t headroom_peak;      /* high water mark of headroom_bytes */
+    size_t headroom_reclaimed; /* headroom given back under memory pressure */
+    size_t calloc_bytes;       /* bytes asked for through mm_calloc */
+    size_t calloc_cleared;     /* of those, bytes mm_calloc had to memset */
+} mm_stats_t;
+
+/*
+ * Realloc headroom: a block that mm_realloc grows a second time gets
+ * MM_REALLOC_HEADROOM percent extra, so the next reallocs stay in place.
+ * The headroom is given back when the heap would otherwise have to grow.
+ */
+#define MM_REALLOC_HEADROOM 50
+
+/*
+ * Placement policies of the segregated free lists, switched at run time
+ * with mm_set_policy() (-1 for an unknown policy). They all share one
+ * block format. Blocks in the red-black tree are always best fit.
+ */
+#define MM_POLICY_FIRST_FIT  0 /* LIFO lists, first block that fits (default) */
+#define MM_POLICY_NEXT_FIT   1 /* LIFO lists, each search resumes at a roving pointer */
+#define MM_POLICY_BEST_OF_N  2 /* LIFO lists, smallest of the first few blocks that fit */
+#define MM_POLICY_ADDR_ORDER 3 /* lists sorted by address, first block that fits */
+#define MM_NUM_POLICIES      4
+
+/*
+ * Heap growth: mm_set_heap_growth() makes every heap extension at least
+ * min_chunk bytes. The chunk doubles while the heap keeps growing but
+ * stays at most percent of the heap; larger requests grow it exactly.
+ */
+extern void mm_set_heap_growth(size_t min_chunk, int percent);
+
+/*
+ * Slab spans: the pages of the small object slabs are carved from spans
+ * of up to MM_SLAB_SPAN pages, a sub-heap apart from the larger blocks.
+ * A page a slab gives back is reused by a slab of any size.
+ * mm_set_slab_span(1) carves every slab page from the heap on its own.
+ */
+#define MM_SLAB_SPAN 16
+
+extern void mm_set_slab_span(int pages);
+
+/*
+ * Lifetime hints: mm_malloc_hint() places MM_SHORT_LIVED blocks (request
+ * scoped buffers) in regions of their own, away from MM_LONG_LIVED ones,
+ * so freeing them leaves large runs instead of holes. Blocks of either
+ * kind are freed and reallocated as usual.
+ */
+#define MM_SHORT_LIVED 1
+#define MM_LONG_LIVED  2
+
+extern void *mm_malloc_hint(size_t size, int hint);
+
+/*
+ * Batches: mm_malloc_batch() allocates n blocks of size bytes into out[]
+ * with one free list search (or heap extension) per group of blocks and
+ * returns how many it got. mm_free_batch() frees n blocks, sorting ptrs[]
+ * by address so that neighbours are coalesced in one step.
+ */
+extern size_t mm_malloc_batch(size_t size, size_t n, void **out);
+extern void mm_free_batch(void **ptrs, size_t n);
+
+/*
+ * Sized free: mm_free_sized() takes the size the block was allocated (or
+ * last reallocated) with, as C++ sized delete does. Sizes too large for
+ * the slab and short-lived tiers skip their page map lookup. Built with
+ * -DMM_DEBUG the size is checked against the block and a mismatch aborts.
+ */
+extern void mm_free_sized(void *ptr, size_t size);
+
+/*
+ * Aligned allocation: mm_memalign() returns a payload aligned to align,
+ * a power of two (NULL otherwise). The block is carved out of a free
+ * block and the fragments before and after it go back to the free
+ * lists. mm_aligned_alloc() is the C11 flavour, the size must be a
+ * multiple of align. Both blocks are freed with mm_free.
+ */
+extern void *mm_memalign(size_t align, size_t size);
+extern void *mm_aligned_alloc(size_t align, size_t size);
+
+/*
+ * Zeroed allocation: mm_calloc() returns nmemb * size zeroed bytes, or
+ * NULL if the product overflows. Heap memory that was never written
+ * (above the highest break so far) and new mappings are already zero
+ * and are not cleared again; everything else is.
+ */
+extern void *mm_calloc(size_t nmemb, size_t size);
+
+/*
+ * Allocation slack: a block is often larger than asked for (a remainder
+ * too small to split stays with it, a slot rounds up to its class).
+ * mm_usable_size() returns how many bytes the block behind ptr holds,
+ * all of which the caller may use; mm_malloc_at_least() mallocs and
+ * stores that count in *actual, so a container can grow into the slack
+ * without another mm_realloc.
+ */
+extern size_t mm_usable_size(void *ptr);
+extern void *mm_malloc_at_least(size_t size, size_t *actual);
+extern int mm_set_policy(int policy);
+extern void mm_set_fastbin_limit(size_t bytes);
+extern void mm_set_realloc_headroom(int percent);
+extern void mm_set_copy_timing(int on);
+extern void mm_get_stats(mm_stats_t *stats);
+
 typedef struct {
     char *teamname;
     char *name1;
@@ -89,6 +89,11 @@ while ($line = <STDIN>) {
 	next;
     }
 
+    # zeroed [c] and aligned [m] allocates are checked like any other
+    if ($cmd eq "c" or $cmd eq "m") {
+	$cmd = "a";
+    }
+
     if ($cmd eq "a" and $HASH{$id} eq "a") {
 	die "$0: ERROR[$linenum]: allocate with no intervening free.\n";
     }
@@ -0,0 +1,94 @@
+#!/usr/bin/perl
+#!/usr/local/bin/perl
+
+# Hash tables that zero everything they allocate: each table callocs its
+# records and an array of 16 byte buckets that doubles (the old one is
+# freed) when the table gets full. Four tables are filled at a time; a
+# table that reaches its size (128 to 16384 records) is dropped and a
+# new one started, so the callocs are served from fresh heap, from
+# recycled blocks and, for the largest bucket arrays, from mappings.
+
+$out_filename = "calloc-bal.rep";
+$num_tables = 16;
+$open_tables = 4;
+srand(15213);
+
+# Open output file
+open OUTFILE, ">$out_filename" or die "Cannot create $out_filename\n";
+
+@ops = ();
+$blk = 0;
+$heap = 0;
+
+# a table is [bucket array id, buckets, records, size, record ids...]
+sub new_table {
+	my $buckets = 64;
+	push @ops, "c $blk $buckets 16";
+	$heap += $buckets * 16;
+	return [$blk++, $buckets, 0, int(2 ** (7 + rand(7)))];
+}
+
+sub drop_table {
+	my ($table) = @_;
+	my $i;
+
+	for ($i = 4; $i < @$table; $i += 1) {
+		push @ops, "f $table->[$i]";
+	}
+	push @ops, "f $table->[0]";
+}
+
+@tables = ();
+for ($i = 0; $i < $open_tables; $i += 1) {
+	push @tables, new_table();
+}
+
+for ($done = 0; $done < $num_tables; ) {
+	$table = $tables[int(rand($open_tables))];
+
+	# a record of 24 to 200 bytes
+	$size = 24 + 8 * int(rand(23));
+	push @ops, "c $blk 1 $size";
+	push @$table, $blk++;
+	$heap += $size;
+	$table->[2] += 1;
+
+	# rehash into twice the buckets
+	if ($table->[2] > $table->[1]) {
+		$table->[1] *= 2;
+		push @ops, "c $blk $table->[1] 16";
+		push @ops, "f $table->[0]";
+		$table->[0] = $blk++;
+		$heap += $table->[1] * 16;
+	}
+
+	# a full table is done, a new one takes its place
+	if ($table->[2] >= $table->[3]) {
+		drop_table($table);
+		for ($j = 0; $tables[$j] != $table; $j += 1) {
+		}
+		$tables[$j] = new_table();
+		$done += 1;
+	}
+}
+
+foreach $table (@tables) {
+	drop_table($table);
+}
+
+# Calculate misc parameters
+
+$suggested_heap_size = $heap;
+$num_blocks = $blk;
+$num_ops = @ops;
+
+print OUTFILE "$suggested_heap_size\n";
+print OUTFILE "$num_blocks\n";
+print OUTFILE "$num_ops\n";
+print OUTFILE "1\n";
+
+foreach $op (@ops) {
+	print OUTFILE "$op\n";
+}
+
+close OUTFILE;
@@ -0,0 +1,69 @@
+#!/usr/bin/perl
+#!/usr/local/bin/perl
+
+# A request-serving loop: every request allocates a few scratch buffers
+# and frees them when it ends, and now and then adds an entry to a cache
+# that lives across requests (the oldest entry is evicted once the cache
+# is full). Allocations carry a lifetime hint column, s(hort) for the
+# scratch buffers and l(ong) for the cache entries.
+
+$out_filename = "lifetime-bal.rep";
+$num_requests = 1000;
+$cache_max = 300;
+srand(15213);
+
+# Open output file
+open OUTFILE, ">$out_filename" or die "Cannot create $out_filename\n";
+
+@ops = ();
+@cache = ();
+$blk = 0;
+$heap = 0;
+
+for ($i = 0; $i < $num_requests; $i += 1) {
+	@scratch = ();
+	$num_scratch = 4 + int(rand(8));
+
+	for ($j = 0; $j < $num_scratch; $j += 1) {
+		$size = 32 + int(rand(2016));
+		push @ops, "a $blk $size s";
+		push @scratch, $blk++;
+
+		# a cache entry is made in the middle of the request
+		if (rand() < 0.15) {
+			$size = 64 + int(rand(448));
+			push @ops, "a $blk $size l";
+			push @cache, $blk++;
+			$heap += $size;
+			if (@cache > $cache_max) {
+				$old = shift @cache;
+				push @ops, "f $old";
+			}
+		}
+	}
+
+	foreach $id (@scratch) {
+		push @ops, "f $id";
+	}
+}
+
+foreach $id (@cache) {
+	push @ops, "f $id";
+}
+
+# Calculate misc parameters
+
+$suggested_heap_size = $heap + 16*2048;
+$num_blocks = $blk;
+$num_ops = @ops;
+
+print OUTFILE "$suggested_heap_size\n";
+print OUTFILE "$num_blocks\n";
+print OUTFILE "$num_ops\n";
+print OUTFILE "1\n";
+
+foreach $op (@ops) {
+	print OUTFILE "$op\n";
+}
+
+close OUTFILE;
@@ -0,0 +1,71 @@
+#!/usr/bin/perl
+#!/usr/local/bin/perl
+
+# SIMD buffers (32 byte aligned), cache line isolated counters (64 byte
+# aligned) and page aligned I/O buffers, mixed with plain mallocs. A
+# random half of the live blocks is freed now and then, so the aligned
+# blocks are carved out of free blocks as well as out of the top.
+
+$out_filename = "memalign-bal.rep";
+$num_allocs = 6000;
+$max_live = 400;
+srand(15213);
+
+# Open output file
+open OUTFILE, ">$out_filename" or die "Cannot create $out_filename\n";
+
+@ops = ();
+@live = ();
+$blk = 0;
+$heap = 0;
+
+for ($i = 0; $i < $num_allocs; $i += 1) {
+	$kind = rand();
+	if ($kind < 0.2) {
+		$size = 32 * (1 + int(rand(32)));
+		push @ops, "m $blk 32 $size";
+	} elsif ($kind < 0.35) {
+		$size = 8 * (1 + int(rand(8)));
+		push @ops, "m $blk 64 $size";
+	} elsif ($kind < 0.4) {
+		$size = 4096 * (1 + int(rand(2)));
+		push @ops, "m $blk 4096 $size";
+	} else {
+		$size = 16 + int(rand(1000));
+		push @ops, "a $blk $size";
+	}
+	push @live, $blk++;
+	$heap += $size;
+
+	if (@live >= $max_live) {
+		for ($j = @live - 1; $j > 0; $j -= 1) {
+			$k = int(rand($j + 1));
+			@live[$j, $k] = @live[$k, $j];
+		}
+		while (@live > $max_live / 2) {
+			$id = pop @live;
+			push @ops, "f $id";
+		}
+	}
+}
+
+foreach $id (@live) {
+	push @ops, "f $id";
+}
+
+# Calculate misc parameters
+
+$suggested_heap_size = $heap;
+$num_blocks = $blk;
+$num_ops = @ops;
+
+print OUTFILE "$suggested_heap_size\n";
+print OUTFILE "$num_blocks\n";
+print OUTFILE "$num_ops\n";
+print OUTFILE "1\n";
+
+foreach $op (@ops) {
+	print OUTFILE "$op\n";
+}
+
+close OUTFILE;
@@ -0,0 +1,67 @@
+#!/usr/bin/perl
+#!/usr/local/bin/perl
+
+# Request handlers that allocate a few dozen nodes of one size at once
+# and free them together when the request is done. A small set of
+# blocks from earlier requests stays allocated in between, so the
+# nodes are carved next to live blocks.
+
+$out_filename = "nodes-bal.rep";
+$num_requests = 300;
+$nodes_per_request = 48;
+$node_size = 192;
+$keep_size = 1000;
+srand(15213);
+
+# Open output file
+open OUTFILE, ">$out_filename" or die "Cannot create $out_filename\n";
+
+@ops = ();
+@kept = ();
+$blk = 0;
+
+for ($i = 0; $i < $num_requests; $i += 1) {
+	@nodes = ();
+	for ($j = 0; $j < $nodes_per_request; $j += 1) {
+		push @ops, "a $blk $node_size";
+		push @nodes, $blk++;
+	}
+
+	# every request leaves one block behind, the oldest one goes
+	push @ops, "a $blk $keep_size";
+	push @kept, $blk++;
+	if (@kept > 16) {
+		$old = shift @kept;
+		push @ops, "f $old";
+	}
+
+	# the nodes go in no particular order
+	for ($j = @nodes - 1; $j > 0; $j -= 1) {
+		$k = int(rand($j + 1));
+		@nodes[$j, $k] = @nodes[$k, $j];
+	}
+	foreach $id (@nodes) {
+		push @ops, "f $id";
+	}
+}
+
+foreach $id (@kept) {
+	push @ops, "f $id";
+}
+
+# Calculate misc parameters
+
+$suggested_heap_size = $nodes_per_request*$node_size + 17*$keep_size;
+$num_blocks = $blk;
+$num_ops = @ops;
+
+print OUTFILE "$suggested_heap_size\n";
+print OUTFILE "$num_blocks\n";
+print OUTFILE "$num_ops\n";
+print OUTFILE "1\n";
+
+foreach $op (@ops) {
+	print OUTFILE "$op\n";
+}
+
+close OUTFILE;
@@ -0,0 +1,48 @@
+#!/usr/bin/perl
+#!/usr/local/bin/perl
+
+# A string builder: one buffer is grown with realloc, one append at a
+# time, up to $final_size bytes. Every append also allocates the piece
+# being appended and frees the previous one.
+
+$out_filename = "stringbuild-bal.rep";
+$append_size = 1024*1024;
+$final_size = 64*1024*1024;
+$piece_size = 4096;
+
+# Open output file
+open OUTFILE, ">$out_filename" or die "Cannot create $out_filename\n";
+
+# Calculate misc parameters
+
+$num_iters = $final_size / $append_size;
+$suggested_heap_size = $final_size + $piece_size*2;
+$num_blocks = $num_iters+1;
+$num_ops = ($num_iters-1)*3 +4;
+$blk = 1;
+$buffer_size = $append_size;
+
+print OUTFILE "$suggested_heap_size\n"; 
+print OUTFILE "$num_blocks\n";
+print OUTFILE "$num_ops\n";
+print OUTFILE "1\n"; 
+
+print OUTFILE "a 0 $buffer_size\n";
+print OUTFILE "a $blk $piece_size\n";
+
+for ($i = 1;  $i < $num_iters; $i += 1) { 
+	$blk += 1;
+
+	$buffer_size += $append_size;
+
+	print OUTFILE "a $blk $piece_size\n";
+	print OUTFILE "r 0 $buffer_size\n";
+
+	$prevblk = $blk-1;
+	print OUTFILE "f $prevblk\n";
+}
+
+print OUTFILE "f $blk\n";
+print OUTFILE "f 0\n";
+
+close OUTFILE;
@@ -0,0 +1,71 @@
+#!/usr/bin/perl
+#!/usr/local/bin/perl
+
+# Vectors that grow one element at a time and realloc to the exact size
+# on every push, as plain C code often does. 64 vectors of 1 to 24 byte
+# elements grow side by side; one that reaches its length (16 to 2000
+# elements) is freed and a new one started. A container that knows the
+# usable size of its block only needs a realloc when that is full.
+
+$out_filename = "vector-bal.rep";
+$num_pushes = 40000;
+$num_vectors = 64;
+@elem_sizes = (1, 4, 8, 12, 16, 24);
+srand(15213);
+
+# Open output file
+open OUTFILE, ">$out_filename" or die "Cannot create $out_filename\n";
+
+@ops = ();
+$blk = 0;
+$heap = 0;
+
+# a vector is [id, element size, elements, length]
+sub new_vector {
+	my $elem = $elem_sizes[int(rand(@elem_sizes))];
+	push @ops, "a $blk $elem";
+	$heap += $elem;
+	return [$blk++, $elem, 1, 16 + int(rand(1985))];
+}
+
+@vectors = ();
+for ($i = 0; $i < $num_vectors; $i += 1) {
+	push @vectors, new_vector();
+}
+
+for ($i = 0; $i < $num_pushes; $i += 1) {
+	$j = int(rand($num_vectors));
+	$vector = $vectors[$j];
+
+	$vector->[2] += 1;
+	$size = $vector->[1] * $vector->[2];
+	push @ops, "r $vector->[0] $size";
+	$heap += $vector->[1];
+
+	# a full vector is done, a new one takes its place
+	if ($vector->[2] >= $vector->[3]) {
+		push @ops, "f $vector->[0]";
+		$vectors[$j] = new_vector();
+	}
+}
+
+foreach $vector (@vectors) {
+	push @ops, "f $vector->[0]";
+}
+
+# Calculate misc parameters
+
+$suggested_heap_size = $heap;
+$num_blocks = $blk;
+$num_ops = @ops;
+
+print OUTFILE "$suggested_heap_size\n";
+print OUTFILE "$num_blocks\n";
+print OUTFILE "$num_ops\n";
+print OUTFILE "1\n";
+
+foreach $op (@ops) {
+	print OUTFILE "$op\n";
+}
+
+close OUTFILE;